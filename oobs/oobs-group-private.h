@@ -27,17 +27,41 @@ G_BEGIN_DECLS
 
 #include "oobs-group.h"
 
+/* Signature of the group struct sent by the backends */
+#define OOBS_GROUP_SIGNATURE "(ssuas)"
+
 
 OobsGroup*
-_oobs_group_create_from_dbus_reply  (OobsObject      *object,
+_oobs_group_create_from_dbus_reply  (OobsGroup       *group,
                                      DBusMessage     *reply,
-                                     DBusMessageIter  struct_iter);
+                                     DBusMessageIter  struct_iter,
+                                     OobsGroupFields  fields);
+
+#ifdef HAVE_GDBUS
+#include <gio/gio.h>
+
+OobsGroup*
+_oobs_group_create_from_variant     (OobsGroup       *group,
+                                     GVariant        *variant,
+                                     OobsGroupFields  fields);
+#endif
 
 void
 _oobs_create_dbus_struct_from_group (OobsGroup       *group,
                                      DBusMessage     *message,
                                      DBusMessageIter *iter);
 
+guint
+_oobs_group_get_serial              (void);
+
+OobsResult
+_oobs_group_prepare_commit          (OobsObject      *object,
+                                     gboolean         blocking);
+
+void
+_oobs_group_remove_users            (OobsGroup       *group,
+                                     GHashTable      *logins);
+
 G_END_DECLS
 
 #endif /* __OOBS_GROUP_PRIVATE_H */
\ No newline at end of file
@@ -55,11 +55,24 @@ struct _OobsGroupPrivate {
   gid_t  gid;
   gulong updated_id;
 
-  /* List of names received from the backends, possibly with unknown users */
-  GList *usernames;
-  /* List of OobsUsers updated from the above, only containing known users,
-   * and working has a cache to access the above from public API. */
-  GList *users;
+  /* Names received from the backends, possibly with unknown users,
+   * in the order they are committed. usernames_set maps each name
+   * to its link in the queue, so membership checks and removals
+   * don't need to walk it. */
+  GQueue     *usernames;
+  GHashTable *usernames_set;
+
+  /* OobsUsers updated from the above, only containing known users,
+   * and working has a cache to access the above from public API.
+   * users_set maps each OobsUser to its link in the queue. */
+  GQueue     *users;
+  GHashTable *users_set;
+
+  /* fields not retrieved on last update, see
+   * oobs_groups_config_set_fields(), and the
+   * ones ensure_fields() is retrieving */
+  OobsGroupFields missing_fields;
+  OobsGroupFields fetching_fields;
 };
 
 static void oobs_group_class_init  (OobsGroupClass *class);
@@ -87,6 +100,10 @@ enum {
   PROP_GID,
 };
 
+/* Bumped whenever the GID of any group changes, so
+ * OobsGroupsConfig knows when to rebuild its indexes */
+static guint groups_serial = 0;
+
 G_DEFINE_TYPE (OobsGroup, oobs_group, OOBS_TYPE_OBJECT);
 
 static void
@@ -104,6 +121,12 @@ oobs_group_class_init (OobsGroupClass *class)
   oobs_class->update = oobs_group_update;
   oobs_class->get_update_message = oobs_group_get_update_message;
 
+  _oobs_object_class_set_reply_signature (oobs_class, OOBS_GROUP_SIGNATURE);
+#ifdef HAVE_GDBUS
+  _oobs_object_class_set_variant_decoding (oobs_class);
+#endif
+  _oobs_object_class_set_prepare_commit_func (oobs_class, _oobs_group_prepare_commit);
+
   g_object_class_install_property (object_class,
 				   PROP_GROUPNAME,
 				   g_param_spec_string ("name",
@@ -141,12 +164,141 @@ oobs_group_init (OobsGroup *group)
   priv->groupname = NULL;
   priv->password  = NULL;
   priv->updated_id = 0;
-  priv->usernames = NULL;
-  priv->users     = NULL;
+  priv->usernames = g_queue_new ();
+  priv->usernames_set = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->users     = g_queue_new ();
+  priv->users_set = g_hash_table_new (NULL, NULL);
 
   group->_priv = priv;
 }
 
+static void
+add_username (OobsGroupPrivate *priv,
+	      const gchar      *login)
+{
+  if (g_hash_table_lookup (priv->usernames_set, login))
+    return;
+
+  g_queue_push_tail (priv->usernames, g_strdup (login));
+  g_hash_table_insert (priv->usernames_set,
+		       priv->usernames->tail->data,
+		       priv->usernames->tail);
+}
+
+static void
+remove_username (OobsGroupPrivate *priv,
+		 const gchar      *login)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (priv->usernames_set, login);
+
+  if (!link)
+    return;
+
+  /* the key is owned by the link */
+  g_hash_table_remove (priv->usernames_set, login);
+  g_free (link->data);
+  g_queue_delete_link (priv->usernames, link);
+}
+
+static void
+clear_usernames (OobsGroupPrivate *priv)
+{
+  g_hash_table_remove_all (priv->usernames_set);
+  g_queue_foreach (priv->usernames, (GFunc) g_free, NULL);
+  g_queue_clear (priv->usernames);
+}
+
+static void
+add_member_user (OobsGroupPrivate *priv,
+		 OobsUser         *user)
+{
+  if (g_hash_table_lookup (priv->users_set, user))
+    return;
+
+  g_queue_push_tail (priv->users, g_object_ref (user));
+  g_hash_table_insert (priv->users_set, user, priv->users->tail);
+}
+
+static void
+remove_member_user (OobsGroupPrivate *priv,
+		    OobsUser         *user)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (priv->users_set, user);
+
+  if (!link)
+    return;
+
+  g_hash_table_remove (priv->users_set, user);
+  g_queue_delete_link (priv->users, link);
+  g_object_unref (user);
+}
+
+static void
+clear_member_users (OobsGroupPrivate *priv)
+{
+  g_hash_table_remove_all (priv->users_set);
+  g_queue_foreach (priv->users, (GFunc) g_object_unref, NULL);
+  g_queue_clear (priv->users);
+}
+
+/*
+ * Retrieves the fields left out by the last update if any of
+ * @fields is among them, see oobs_groups_config_set_fields().
+ * Only those are decoded, so changes to the loaded fields
+ * that weren't committed yet are kept.
+ */
+static OobsResult
+ensure_fields (OobsGroup       *group,
+	       OobsGroupFields  fields)
+{
+  OobsGroupPrivate *priv;
+  OobsResult result;
+
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+
+  if (!(priv->missing_fields & fields))
+    return OOBS_RESULT_OK;
+
+  /* avoid recursing when the update sets the fields */
+  priv->fetching_fields = priv->missing_fields;
+  priv->missing_fields = 0;
+
+  result = oobs_object_update (OOBS_OBJECT (group));
+
+  if (result != OOBS_RESULT_OK)
+    priv->missing_fields = priv->fetching_fields;
+
+  priv->fetching_fields = 0;
+
+  return result;
+}
+
+/*
+ * The whole group is sent, so fields left out by the last update
+ * must be retrieved before committing, the loaded ones keep their
+ * values. Members must be there too, or they'd be removed.
+ */
+OobsResult
+_oobs_group_prepare_commit (OobsObject *object,
+			    gboolean    blocking)
+{
+  OobsGroupPrivate *priv;
+
+  priv = OOBS_GROUP_GET_PRIVATE (OOBS_GROUP (object));
+
+  if (!priv->missing_fields)
+    return OOBS_RESULT_OK;
+
+  if (!blocking)
+    return OOBS_RESULT_MALFORMED_DATA;
+
+  return ensure_fields (OOBS_GROUP (object), OOBS_GROUP_FIELD_ALL);
+}
+
 /*
  * Clear OobsUsers list and fill it with updated references.
  */
@@ -160,18 +312,19 @@ oobs_group_users_updated (OobsGroup        *group,
 
   priv = OOBS_GROUP_GET_PRIVATE (group);
 
-  g_list_foreach (priv->users, (GFunc) g_object_unref, NULL);
-  g_list_free (priv->users);
-  priv->users = NULL;
+  clear_member_users (priv);
 
-  for (l = priv->usernames; l; l = l->next)
+  for (l = priv->usernames->head; l; l = l->next)
     {
       user = oobs_users_config_get_from_login (users_config, l->data);
 
-      /* A reference has already been added by the above call,
-        * keep it until user is removed from list or the group is destroyed. */
+      /* The set keeps its own reference until user is removed
+       * from the group or the group is destroyed. */
       if (user)
-	  priv->users = g_list_prepend (priv->users, user);
+	{
+	  add_member_user (priv, user);
+	  g_object_unref (user);
+	}
     }
 }
 
@@ -205,12 +358,16 @@ oobs_group_set_property (GObject      *object,
   group = OOBS_GROUP (object);
   priv = group->_priv;
 
+  /* setting a field that wasn't retrieved would lose the others */
+  if (prop_id == PROP_PASSWORD)
+    ensure_fields (group, OOBS_GROUP_FIELD_PASSWORD);
+
   switch (prop_id)
     {
     case PROP_GROUPNAME:
       g_free (priv->groupname);
       priv->groupname = g_value_dup_string (value);
-      break;
+      groups_serial++;
       break;
     case PROP_PASSWORD:
       g_free (priv->password);
@@ -218,6 +375,7 @@ oobs_group_set_property (GObject      *object,
       break;
     case PROP_GID:
       priv->gid = g_value_get_uint (value);
+      groups_serial++;
       break;
     }
 }
@@ -236,6 +394,10 @@ oobs_group_get_property (GObject      *object,
   group = OOBS_GROUP (object);
   priv = group->_priv;
 
+  /* missing fields are retrieved on first access */
+  if (prop_id == PROP_PASSWORD)
+    ensure_fields (group, OOBS_GROUP_FIELD_PASSWORD);
+
   switch (prop_id)
     {
     case PROP_GROUPNAME:
@@ -268,11 +430,13 @@ oobs_group_finalize (GObject *object)
 
       g_free (priv->groupname);
 
-      g_list_foreach (priv->usernames, (GFunc) g_free, NULL);
-      g_list_free (priv->usernames);
+      clear_usernames (priv);
+      g_queue_free (priv->usernames);
+      g_hash_table_destroy (priv->usernames_set);
 
-      g_list_foreach (priv->users, (GFunc) g_object_unref, NULL);
-      g_list_free (priv->users);
+      clear_member_users (priv);
+      g_queue_free (priv->users);
+      g_hash_table_destroy (priv->users_set);
 
       /* Erase password field in case it's not done */
       if (priv->password) {
@@ -285,35 +449,71 @@ oobs_group_finalize (GObject *object)
     (* G_OBJECT_CLASS (oobs_group_parent_class)->finalize) (object);
 }
 
+/* Fields of the group struct exchanged with the backends, in
+ * order. Members are sent after these and handled separately. */
+static const UtilsField group_fields[] = {
+  { UTILS_FIELD_STRING, "name",     G_STRUCT_OFFSET (OobsGroupPrivate, groupname), 0, 0 },
+  { UTILS_FIELD_STRING, "password", G_STRUCT_OFFSET (OobsGroupPrivate, password),  OOBS_GROUP_FIELD_PASSWORD, 0 },
+  { UTILS_FIELD_UINT,   "gid",      G_STRUCT_OFFSET (OobsGroupPrivate, gid),       0, 0 }
+};
+
 OobsGroup*
-_oobs_group_create_from_dbus_reply (OobsObject      *object,
+_oobs_group_create_from_dbus_reply (OobsGroup       *group,
                                     DBusMessage     *reply,
-                                    DBusMessageIter  struct_iter)
+                                    DBusMessageIter  struct_iter,
+                                    OobsGroupFields  fields)
 {
-  DBusMessageIter iter;
-  guint32 gid;
-  const gchar *groupname, *passwd;
-  OobsGroup *group;
+  DBusMessageIter iter, name_iter;
   OobsGroupPrivate *priv;
   OobsObject *users_config;
+  GList *usernames, *l;
+  gboolean notify;
 
   dbus_message_iter_recurse (&struct_iter, &iter);
 
-  groupname = utils_get_string (&iter);
-  passwd = utils_get_string (&iter);
-  gid = utils_get_uint (&iter);
+  /* properties are only notified on existing groups */
+  notify = (group != NULL);
+
+  if (!group)
+    {
+      name_iter = iter;
+      group = oobs_group_new (utils_get_string (&name_iter));
+
+      if (!group)
+	return NULL;
+    }
+
+  /* nothing must be retrieved while the fields are being set */
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+  priv->missing_fields = 0;
+
+  /* Fields that were not requested are skipped without being decoded */
+  g_object_freeze_notify (G_OBJECT (group));
+  utils_decode_fields (&iter, group_fields, G_N_ELEMENTS (group_fields), fields,
+		       priv, (notify) ? G_OBJECT (group) : NULL);
+  g_object_thaw_notify (G_OBJECT (group));
+
+  /* name and GID were possibly replaced */
+  groups_serial++;
 
-  group = oobs_group_new (groupname);
-  g_object_set (G_OBJECT (group),
-                "password", passwd,
-                "gid", gid,
-                NULL);
+  /* ensure_fields() already cleared the fields it retrieves */
+  if (!(fields & UTILS_FIELD_MASK_ONLY))
+    priv->missing_fields = OOBS_GROUP_FIELD_ALL & ~fields;
+
+  if (!(fields & OOBS_GROUP_FIELD_MEMBERS))
+    return group;
 
   /* This list is kept in this form rather than as OobsUsers* because
    * we don't want to remove unknown users from groups (users not in
    * /etc/passwd such as that from LDAP). */
-  priv = OOBS_GROUP_GET_PRIVATE (group);
-  priv->usernames = utils_get_string_list_from_dbus_reply (reply, &iter);
+  clear_usernames (priv);
+  usernames = utils_get_string_list_from_dbus_reply (reply, &iter);
+
+  for (l = usernames; l; l = l->next)
+    add_username (priv, l->data);
+
+  g_list_foreach (usernames, (GFunc) g_free, NULL);
+  g_list_free (usernames);
 
   /* just update users if the object was already
    * updated, update will be forced later if required
@@ -323,8 +523,72 @@ _oobs_group_create_from_dbus_reply (OobsObject      *object,
     oobs_group_users_updated (group,
                               OOBS_USERS_CONFIG (users_config));
 
-  return OOBS_GROUP (group);
+  return group;
+}
+
+#ifdef HAVE_GDBUS
+/*
+ * GDBus counterpart of _oobs_group_create_from_dbus_reply(), decodes
+ * a (ssuas) group struct straight from the reply body.
+ */
+OobsGroup*
+_oobs_group_create_from_variant (OobsGroup       *group,
+				 GVariant        *variant,
+				 OobsGroupFields  fields)
+{
+  OobsGroupPrivate *priv;
+  OobsObject *users_config;
+  GVariantIter *members_iter;
+  const gchar *name;
+  gboolean notify;
+
+  notify = (group != NULL);
+
+  if (!group)
+    {
+      g_variant_get_child (variant, 0, "&s", &name);
+      group = oobs_group_new ((*name) ? name : NULL);
+
+      if (!group)
+	return NULL;
+    }
+
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+  priv->missing_fields = 0;
+
+  g_object_freeze_notify (G_OBJECT (group));
+  utils_decode_variant_fields (variant, group_fields, G_N_ELEMENTS (group_fields), fields,
+			       priv, (notify) ? G_OBJECT (group) : NULL);
+  g_object_thaw_notify (G_OBJECT (group));
+
+  groups_serial++;
+
+  if (!(fields & UTILS_FIELD_MASK_ONLY))
+    priv->missing_fields = OOBS_GROUP_FIELD_ALL & ~fields;
+
+  if (!(fields & OOBS_GROUP_FIELD_MEMBERS))
+    return group;
+
+  /* see _oobs_group_create_from_dbus_reply() */
+  clear_usernames (priv);
+  g_variant_get_child (variant, 3, "as", &members_iter);
+
+  while (g_variant_iter_next (members_iter, "&s", &name))
+    {
+      if (*name)
+	add_username (priv, name);
+    }
+
+  g_variant_iter_free (members_iter);
+
+  users_config = oobs_users_config_get ();
+  if (oobs_object_has_updated (users_config))
+    oobs_group_users_updated (group,
+                              OOBS_USERS_CONFIG (users_config));
+
+  return group;
 }
+#endif
 
 void
 _oobs_create_dbus_struct_from_group (OobsGroup       *group,
@@ -333,29 +597,19 @@ _oobs_create_dbus_struct_from_group (OobsGroup       *group,
 {
   OobsGroupPrivate *priv;
   DBusMessageIter struct_iter;
-  guint32 gid;
-  gchar *groupname, *passwd;
 
   priv = OOBS_GROUP_GET_PRIVATE (group);
 
-  g_object_get (group,
-		"name", &groupname,
-		"password", &passwd,
-		"gid",  &gid,
-		NULL);
+  /* fields are read directly, _oobs_group_prepare_commit()
+   * already retrieved them if missing, so this doesn't block */
+  ensure_fields (group, OOBS_GROUP_FIELD_ALL);
 
   dbus_message_iter_open_container (array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
 
-  utils_append_string (&struct_iter, groupname);
-  utils_append_string (&struct_iter, passwd);
-  utils_append_uint (&struct_iter, gid);
-
-  utils_create_dbus_array_from_string_list (priv->usernames, message, &struct_iter);
+  utils_encode_fields (&struct_iter, group_fields, G_N_ELEMENTS (group_fields), priv);
+  utils_create_dbus_array_from_string_list (priv->usernames->head, message, &struct_iter);
 
   dbus_message_iter_close_container (array_iter, &struct_iter);
-
-  g_free (groupname);
-  g_free (passwd);
 }
 
 static void
@@ -365,12 +619,12 @@ oobs_group_commit (OobsObject *object)
   DBusMessage *message;
   DBusMessageIter iter;
 
+  priv = OOBS_GROUP_GET_PRIVATE (OOBS_GROUP (object));
   message = _oobs_object_get_dbus_message (object);
   dbus_message_iter_init_append (message, &iter);
   _oobs_create_dbus_struct_from_group (OOBS_GROUP (object), message, &iter);
 
   /* Erase password field as soon as possible */
-  priv = OOBS_GROUP_GET_PRIVATE (OOBS_GROUP (object));
   if (priv->password)
     memset (priv->password, 0, strlen (priv->password));
 }
@@ -396,13 +650,38 @@ oobs_group_get_update_message (OobsObject *object)
 static void
 oobs_group_update (OobsObject *object)
 {
+  OobsGroupPrivate *priv;
   DBusMessage *reply;
   DBusMessageIter iter;
+  guint fields;
+#ifdef HAVE_GDBUS
+  GVariant *body, *group_variant;
+#endif
 
-  reply = _oobs_object_get_dbus_message (object);
+  priv = OOBS_GROUP_GET_PRIVATE (OOBS_GROUP (object));
 
+  if (priv->fetching_fields)
+    fields = priv->fetching_fields | UTILS_FIELD_MASK_ONLY;
+  else
+    fields = OOBS_GROUP_FIELD_ALL;
+
+#ifdef HAVE_GDBUS
+  body = _oobs_object_get_reply_variant (object);
+
+  if (body && g_variant_is_of_type (body, G_VARIANT_TYPE ("(" OOBS_GROUP_SIGNATURE ")")))
+    {
+      group_variant = g_variant_get_child_value (body, 0);
+      _oobs_group_create_from_variant (OOBS_GROUP (object), group_variant,
+				       (OobsGroupFields) fields);
+      g_variant_unref (group_variant);
+      return;
+    }
+#endif
+
+  reply = _oobs_object_get_dbus_message (object);
   dbus_message_iter_init (reply, &iter);
-  _oobs_group_create_from_dbus_reply (object, reply, iter);
+  _oobs_group_create_from_dbus_reply (OOBS_GROUP (object), reply, iter,
+				      (OobsGroupFields) fields);
 }
 
 /**
@@ -518,8 +797,53 @@ oobs_group_get_users (OobsGroup *group)
   g_return_val_if_fail (OOBS_IS_GROUP (group), NULL);
 
   priv = OOBS_GROUP_GET_PRIVATE (group);
+  ensure_fields (group, OOBS_GROUP_FIELD_MEMBERS);
+
+  return g_list_copy (priv->users->head);
+}
+
+/**
+ * oobs_group_contains_user:
+ * @group: An #OobsGroup.
+ * @user: An #OobsUser.
+ *
+ * Checks whether @user is a member of @group.
+ *
+ * Return Value: %TRUE if @user is in @group, %FALSE otherwise.
+ **/
+gboolean
+oobs_group_contains_user (OobsGroup *group,
+			  OobsUser  *user)
+{
+  OobsGroupPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_GROUP (group), FALSE);
+  g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
+
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+  ensure_fields (group, OOBS_GROUP_FIELD_MEMBERS);
+
+  return (g_hash_table_lookup (priv->users_set, user) != NULL);
+}
+
+/**
+ * oobs_group_clear_users:
+ * @group: An #OobsGroup.
+ *
+ * Removes all the users from the group.
+ **/
+void
+oobs_group_clear_users (OobsGroup *group)
+{
+  OobsGroupPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_GROUP (group));
+
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+  ensure_fields (group, OOBS_GROUP_FIELD_MEMBERS);
 
-  return g_list_copy (priv->users);
+  clear_usernames (priv);
+  clear_member_users (priv);
 }
 
 /**
@@ -541,18 +865,18 @@ oobs_group_add_user (OobsGroup *group,
   g_return_if_fail (OOBS_IS_USER (user));
   
   priv = OOBS_GROUP_GET_PRIVATE (group);
+  ensure_fields (group, OOBS_GROUP_FIELD_MEMBERS);
 
   login = oobs_user_get_login_name (user);
 
   /* Update usernames list and OobsUsers list. First is used to commit,
    * second is used for public API. */
 
-  /* Try to avoid several occurrences */
-  if (!g_list_find_custom (priv->usernames, login, (GCompareFunc) strcmp))
-    priv->usernames = g_list_prepend (priv->usernames, g_strdup (login));
+  /* Both are sets, so there are no several occurrences */
+  if (login)
+    add_username (priv, login);
 
-  if (!g_list_find (priv->users, user))
-    priv->users = g_list_prepend (priv->users, g_object_ref (user));
+  add_member_user (priv, user);
 }
 
 /**
@@ -568,30 +892,61 @@ oobs_group_remove_user (OobsGroup *group,
 			OobsUser  *user)
 {
   OobsGroupPrivate *priv;
-  GList *l;
   const char *login;
 
   g_return_if_fail (OOBS_IS_GROUP (group));
   g_return_if_fail (OOBS_IS_USER (user));
   
   priv = OOBS_GROUP_GET_PRIVATE (group);
+  ensure_fields (group, OOBS_GROUP_FIELD_MEMBERS);
 
   login = oobs_user_get_login_name (user);
 
   /* Update usernames list and OobsUsers list. First is used to commit,
    * second is used for public API. */
+  if (login)
+    remove_username (priv, login);
 
-  /* There might be several instances */
-  while ((l = g_list_find_custom (priv->usernames, login, (GCompareFunc) strcmp)))
+  remove_member_user (priv, user);
+}
+
+guint
+_oobs_group_get_serial (void)
+{
+  return groups_serial;
+}
+
+/*
+ * Removes from the group all the users whose login is in the
+ * @logins set, in a single pass over the members.
+ */
+void
+_oobs_group_remove_users (OobsGroup  *group,
+                          GHashTable *logins)
+{
+  OobsGroupPrivate *priv;
+  GList *l, *next;
+
+  priv = OOBS_GROUP_GET_PRIVATE (group);
+
+  /* members will be retrieved without the users anyway */
+  if (priv->missing_fields & OOBS_GROUP_FIELD_MEMBERS)
+    return;
+
+  for (l = priv->usernames->head; l; l = next)
     {
-      g_free (l->data);
-      priv->usernames = g_list_delete_link (priv->usernames, l);
+      next = l->next;
+
+      if (g_hash_table_lookup (logins, l->data))
+	remove_username (priv, l->data);
     }
 
-  while ((l = g_list_find (priv->users, user)))
+  for (l = priv->users->head; l; l = next)
     {
-      g_object_unref (user);
-      priv->users = g_list_delete_link (priv->users, l);
+      next = l->next;
+
+      if (g_hash_table_lookup (logins, oobs_user_get_login_name (l->data)))
+	remove_member_user (priv, l->data);
     }
 }
 
@@ -51,6 +51,21 @@ struct _OobsGroupClass {
   void (*_oobs_padding2) (void);
 };
 
+/**
+ * OobsGroupFields:
+ * @OOBS_GROUP_FIELD_PASSWORD: Crypted password.
+ * @OOBS_GROUP_FIELD_MEMBERS: Users that are members of the group.
+ * @OOBS_GROUP_FIELD_ALL: All of the above.
+ *
+ * Optional fields of an #OobsGroup, the name and GID are always
+ * retrieved. See oobs_groups_config_set_fields().
+ */
+typedef enum {
+  OOBS_GROUP_FIELD_PASSWORD = 1,
+  OOBS_GROUP_FIELD_MEMBERS  = 1 << 1,
+  OOBS_GROUP_FIELD_ALL      = (1 << 2) - 1
+} OobsGroupFields;
+
 GType oobs_group_get_type (void);
 
 OobsGroup* oobs_group_new (const gchar *name);
@@ -66,6 +81,7 @@ GList     *oobs_group_get_users    (OobsGroup *group);
 void       oobs_group_clear_users  (OobsGroup *group);
 void       oobs_group_add_user     (OobsGroup *group, OobsUser *user);
 void       oobs_group_remove_user  (OobsGroup *group, OobsUser *user);
+gboolean   oobs_group_contains_user (OobsGroup *group, OobsUser *user);
 
 gboolean   oobs_group_is_root      (OobsGroup *group);
 
@@ -52,6 +52,23 @@ struct _OobsGroupsConfigPrivate
 
   gid_t     minimum_gid;
   gid_t     maximum_gid;
+
+  /* name -> OobsGroup and GID -> OobsGroup, pointing to
+   * the first group in the list with that name or GID */
+  GHashTable *names_index;
+  GHashTable *gids_index;
+
+  /* _oobs_list_get_serial() and _oobs_group_get_serial()
+   * values when the indexes were last known to be valid */
+  guint list_serial;
+  guint groups_serial;
+  guint index_valid : 1;
+
+  /* whether any name or GID was used by more than one group */
+  guint index_shadowed : 1;
+
+  /* see oobs_groups_config_set_fields() */
+  OobsGroupFields fields;
 };
 
 static void oobs_groups_config_class_init  (OobsGroupsConfigClass *class);
@@ -69,6 +86,9 @@ static void oobs_groups_config_get_property (GObject      *object,
 
 static void oobs_groups_config_update     (OobsObject   *object);
 static void oobs_groups_config_commit     (OobsObject   *object);
+static OobsResult oobs_groups_config_prepare_commit (OobsObject *object,
+						     gboolean    blocking);
+static void oobs_groups_config_get_update_message (OobsObject *object);
 
 
 enum {
@@ -92,6 +112,13 @@ oobs_groups_config_class_init (OobsGroupsConfigClass *class)
 
   oobs_object_class->commit = oobs_groups_config_commit;
   oobs_object_class->update = oobs_groups_config_update;
+  oobs_object_class->get_update_message = oobs_groups_config_get_update_message;
+
+  _oobs_object_class_set_reply_signature (oobs_object_class, "a" OOBS_GROUP_SIGNATURE "uu");
+#ifdef HAVE_GDBUS
+  _oobs_object_class_set_variant_decoding (oobs_object_class);
+#endif
+  _oobs_object_class_set_prepare_commit_func (oobs_object_class, oobs_groups_config_prepare_commit);
 
   g_object_class_install_property (object_class,
 				   PROP_MINIMUM_GID,
@@ -122,6 +149,9 @@ oobs_groups_config_init (OobsGroupsConfig *config)
 
   config->_priv = priv;
   priv->groups_list = _oobs_list_new (OOBS_TYPE_GROUP);
+  priv->names_index = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->gids_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->fields = OOBS_GROUP_FIELD_ALL;
 }
 
 static void
@@ -134,7 +164,11 @@ oobs_groups_config_finalize (GObject *object)
   priv = OOBS_GROUPS_CONFIG (object)->_priv;
 
   if (priv)
+    {
       g_object_unref (priv->groups_list);
+      g_hash_table_destroy (priv->names_index);
+      g_hash_table_destroy (priv->gids_index);
+    }
 
   if (G_OBJECT_CLASS (oobs_groups_config_parent_class)->finalize)
     (* G_OBJECT_CLASS (oobs_groups_config_parent_class)->finalize) (object);
@@ -187,32 +221,111 @@ oobs_groups_config_get_property (GObject      *object,
 }
 
 static void
-oobs_groups_config_update (OobsObject *object)
+index_group (OobsGroupsConfigPrivate *priv,
+	     OobsGroup               *group)
+{
+  const gchar *name;
+  gpointer gid;
+
+  name = oobs_group_get_name (group);
+  gid = GUINT_TO_POINTER (oobs_group_get_gid (group));
+
+  /* keep the first group, as the lookup functions always did */
+  if (name)
+    {
+      if (!g_hash_table_lookup (priv->names_index, name))
+	g_hash_table_insert (priv->names_index, (gpointer) name, group);
+      else
+	priv->index_shadowed = TRUE;
+    }
+
+  if (!g_hash_table_lookup (priv->gids_index, gid))
+    g_hash_table_insert (priv->gids_index, gid, group);
+  else
+    priv->index_shadowed = TRUE;
+}
+
+static void
+stamp_index (OobsGroupsConfigPrivate *priv)
+{
+  priv->list_serial = _oobs_list_get_serial (priv->groups_list);
+  priv->groups_serial = _oobs_group_get_serial ();
+  priv->index_valid = TRUE;
+}
+
+static void
+clear_index (OobsGroupsConfigPrivate *priv)
+{
+  g_hash_table_remove_all (priv->names_index);
+  g_hash_table_remove_all (priv->gids_index);
+  priv->index_shadowed = FALSE;
+}
+
+/*
+ * Rebuilds the indexes if the groups list has been modified
+ * or any group has been renamed or changed its GID since
+ * they were built.
+ */
+static void
+ensure_index (OobsGroupsConfig *config)
 {
   OobsGroupsConfigPrivate *priv;
-  DBusMessage     *reply;
-  DBusMessageIter  iter, elem_iter;
-  OobsListIter     list_iter;
-  GObject         *group;
+  OobsListIter list_iter;
+  GObject *group;
+  gboolean valid;
 
-  priv  = OOBS_GROUPS_CONFIG (object)->_priv;
-  reply = _oobs_object_get_dbus_message (object);
+  priv = config->_priv;
 
-  /* First of all, free the previous configuration */
-  oobs_list_clear (priv->groups_list);
+  if (priv->index_valid &&
+      priv->list_serial == _oobs_list_get_serial (priv->groups_list) &&
+      priv->groups_serial == _oobs_group_get_serial ())
+    return;
 
-  dbus_message_iter_init (reply, &iter);
-  dbus_message_iter_recurse (&iter, &elem_iter);
+  clear_index (priv);
+  valid = oobs_list_get_iter_first (priv->groups_list, &list_iter);
 
-  while (dbus_message_iter_get_arg_type (&elem_iter) == DBUS_TYPE_STRUCT)
+  while (valid)
     {
-      group = G_OBJECT (_oobs_group_create_from_dbus_reply (object, reply, elem_iter));
+      /* the list keeps the group alive */
+      group = oobs_list_get (priv->groups_list, &list_iter);
+      index_group (priv, OOBS_GROUP (group));
+      g_object_unref (group);
+
+      valid = oobs_list_iter_next (priv->groups_list, &list_iter);
+    }
+
+  stamp_index (priv);
+}
+
+static void
+append_group (OobsGroupsConfigPrivate *priv,
+	      OobsGroup               *group)
+{
+  OobsListIter list_iter;
 
-      oobs_list_append (priv->groups_list, &list_iter);
-      oobs_list_set    (priv->groups_list, &list_iter, G_OBJECT (group));
+  /* groups without name are unusable */
+  if (!group)
+    return;
 
-      g_object_unref   (group);
+  oobs_list_append (priv->groups_list, &list_iter);
+  oobs_list_set    (priv->groups_list, &list_iter, G_OBJECT (group));
+  index_group (priv, group);
+
+  g_object_unref (group);
+}
+
+static void
+update_from_message (OobsGroupsConfigPrivate *priv,
+		     DBusMessage             *reply)
+{
+  DBusMessageIter  iter, elem_iter;
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &elem_iter);
 
+  while (dbus_message_iter_get_arg_type (&elem_iter) == DBUS_TYPE_STRUCT)
+    {
+      append_group (priv, _oobs_group_create_from_dbus_reply (NULL, reply, elem_iter, priv->fields));
       dbus_message_iter_next (&elem_iter);
     }
 
@@ -222,6 +335,87 @@ oobs_groups_config_update (OobsObject *object)
   priv->maximum_gid = utils_get_uint (&iter);
 }
 
+#ifdef HAVE_GDBUS
+#define GROUPS_REPLY_TYPE "(a" OOBS_GROUP_SIGNATURE "uu)"
+
+/*
+ * Same as update_from_message(), for replies received through
+ * GDBus: groups are decoded from the body without converting it.
+ */
+static void
+update_from_variant (OobsGroupsConfigPrivate *priv,
+		     GVariant                *body)
+{
+  GVariant     *groups, *group_variant;
+  GVariantIter  groups_iter;
+  guint32       minimum_gid, maximum_gid;
+
+  g_variant_get (body, "(@a" OOBS_GROUP_SIGNATURE "uu)",
+		 &groups, &minimum_gid, &maximum_gid);
+
+  priv->minimum_gid = minimum_gid;
+  priv->maximum_gid = maximum_gid;
+
+  g_variant_iter_init (&groups_iter, groups);
+
+  while ((group_variant = g_variant_iter_next_value (&groups_iter)) != NULL)
+    {
+      append_group (priv, _oobs_group_create_from_variant (NULL, group_variant, priv->fields));
+      g_variant_unref (group_variant);
+    }
+
+  g_variant_unref (groups);
+}
+#endif
+
+static void
+oobs_groups_config_update (OobsObject *object)
+{
+  OobsGroupsConfigPrivate *priv;
+#ifdef HAVE_GDBUS
+  GVariant *body;
+#endif
+
+  priv  = OOBS_GROUPS_CONFIG (object)->_priv;
+
+  /* First of all, free the previous configuration */
+  oobs_list_clear (priv->groups_list);
+  clear_index (priv);
+
+#ifdef HAVE_GDBUS
+  body = _oobs_object_get_reply_variant (object);
+
+  if (body && g_variant_is_of_type (body, G_VARIANT_TYPE (GROUPS_REPLY_TYPE)))
+    update_from_variant (priv, body);
+  else
+#endif
+    update_from_message (priv, _oobs_object_get_dbus_message (object));
+
+  stamp_index (priv);
+}
+
+/*
+ * The fields argument is only appended if a field set is used,
+ * so the default message is understood by any backend.
+ */
+static void
+oobs_groups_config_get_update_message (OobsObject *object)
+{
+  OobsGroupsConfigPrivate *priv;
+  DBusMessageIter iter;
+  DBusMessage *message;
+
+  priv = OOBS_GROUPS_CONFIG (object)->_priv;
+
+  if (priv->fields == OOBS_GROUP_FIELD_ALL)
+    return;
+
+  message = _oobs_object_get_dbus_message (object);
+  dbus_message_iter_init_append (message, &iter);
+
+  utils_append_uint (&iter, priv->fields);
+}
+
 static void
 oobs_groups_config_commit (OobsObject *object)
 {
@@ -267,6 +461,32 @@ oobs_groups_config_commit (OobsObject *object)
   utils_append_uint (&iter, maximum_gid);
 }
 
+/* every group is sent, so all of them must be complete */
+static OobsResult
+oobs_groups_config_prepare_commit (OobsObject *object,
+				   gboolean    blocking)
+{
+  OobsGroupsConfigPrivate *priv;
+  OobsListIter list_iter;
+  OobsResult result = OOBS_RESULT_OK;
+  GObject *group;
+  gboolean valid;
+
+  priv = OOBS_GROUPS_CONFIG (object)->_priv;
+  valid = oobs_list_get_iter_first (priv->groups_list, &list_iter);
+
+  while (valid && result == OOBS_RESULT_OK)
+    {
+      group = oobs_list_get (priv->groups_list, &list_iter);
+      result = _oobs_group_prepare_commit (OOBS_OBJECT (group), blocking);
+
+      g_object_unref (group);
+      valid = oobs_list_iter_next (priv->groups_list, &list_iter);
+    }
+
+  return result;
+}
+
 /**
  * oobs_groups_config_get:
  * 
@@ -337,10 +557,14 @@ oobs_groups_config_add_group (OobsGroupsConfig *config, OobsGroup *group)
     return result;
 
   priv = config->_priv;
+  ensure_index (config);
 
   oobs_list_append (priv->groups_list, &list_iter);
   oobs_list_set (priv->groups_list, &list_iter, G_OBJECT (group));
 
+  index_group (priv, group);
+  stamp_index (priv);
+
   return OOBS_RESULT_OK;
 }
 
@@ -362,6 +586,8 @@ oobs_groups_config_delete_group (OobsGroupsConfig *config, OobsGroup *group)
   OobsListIter list_iter;
   gboolean valid;
   OobsResult result;
+  const gchar *name;
+  gpointer gid;
 
   g_return_val_if_fail (config != NULL, OOBS_RESULT_MALFORMED_DATA);
   g_return_val_if_fail (group != NULL, OOBS_RESULT_MALFORMED_DATA);
@@ -374,11 +600,13 @@ oobs_groups_config_delete_group (OobsGroupsConfig *config, OobsGroup *group)
     return result;
 
   priv = config->_priv;
+  ensure_index (config);
 
   valid = oobs_list_get_iter_first (priv->groups_list, &list_iter);
 
   while (valid) {
     list_group = OOBS_GROUP (oobs_list_get (priv->groups_list, &list_iter));
+    g_object_unref (list_group);
 
     if (list_group == group)
       break;
@@ -386,8 +614,26 @@ oobs_groups_config_delete_group (OobsGroupsConfig *config, OobsGroup *group)
     valid = oobs_list_iter_next (priv->groups_list, &list_iter);
   }
 
+  if (!valid)
+    return OOBS_RESULT_OK;
+
+  name = oobs_group_get_name (group);
+  gid = GUINT_TO_POINTER (oobs_group_get_gid (group));
+
+  if (name && g_hash_table_lookup (priv->names_index, name) == group)
+    g_hash_table_remove (priv->names_index, name);
+
+  if (g_hash_table_lookup (priv->gids_index, gid) == group)
+    g_hash_table_remove (priv->gids_index, gid);
+
   oobs_list_remove (priv->groups_list, &list_iter);
 
+  /* another group might have to take its place in the indexes */
+  if (priv->index_shadowed)
+    priv->index_valid = FALSE;
+  else
+    stamp_index (priv);
+
   return OOBS_RESULT_OK;
 }
 
@@ -405,29 +651,21 @@ oobs_groups_config_delete_group (OobsGroupsConfig *config, OobsGroup *group)
 OobsGroup *
 oobs_groups_config_get_from_name (OobsGroupsConfig *config, const gchar *name)
 {
-  OobsList *groups_list;
-  OobsListIter iter;
+  OobsGroupsConfigPrivate *priv;
   OobsGroup *group;
-  gboolean valid;
-  const gchar *group_name;
-
-  groups_list = oobs_groups_config_get_groups (config);
-  valid = oobs_list_get_iter_first (groups_list, &iter);
 
-  while (valid) {
-    group = OOBS_GROUP (oobs_list_get (groups_list, &iter));
-    group_name = oobs_group_get_name (group);
+  g_return_val_if_fail (OOBS_IS_GROUPS_CONFIG (config), NULL);
+  g_return_val_if_fail (name != NULL, NULL);
 
-    if (group_name && strcmp (name, group_name) == 0)
-      return group;
+  /* ensures the users config is updated too */
+  oobs_groups_config_get_groups (config);
 
-    /* only the returned group is not unreferenced here */
-    g_object_unref (group);
+  priv = config->_priv;
+  ensure_index (config);
 
-    valid = oobs_list_iter_next (groups_list, &iter);
-  }
+  group = g_hash_table_lookup (priv->names_index, name);
 
-  return NULL;
+  return (group) ? g_object_ref (group) : NULL;
 }
 
 /**
@@ -446,31 +684,16 @@ oobs_groups_config_get_from_gid (OobsGroupsConfig *config, gid_t gid)
 {
   OobsGroupsConfigPrivate *priv;
   OobsGroup *group;
-  OobsListIter iter;
-  gboolean valid;
-  gid_t group_gid;
 
   g_return_val_if_fail (config != NULL, NULL);
   g_return_val_if_fail (OOBS_IS_GROUPS_CONFIG (config), NULL);
 
   priv = config->_priv;
+  ensure_index (config);
 
-  valid = oobs_list_get_iter_first (priv->groups_list, &iter);
+  group = g_hash_table_lookup (priv->gids_index, GUINT_TO_POINTER (gid));
 
-  while (valid) {
-    group = OOBS_GROUP (oobs_list_get (priv->groups_list, &iter));
-    group_gid = oobs_group_get_gid (group);
-
-    if (group_gid == gid)
-      return group;
-
-    /* only the returned group is not unreferenced here */
-    g_object_unref (group);
-
-    valid = oobs_list_iter_next (priv->groups_list, &iter);
-  }
-
-  return NULL;
+  return (group) ? g_object_ref (group) : NULL;
 }
 
 /**
@@ -592,3 +815,33 @@ oobs_groups_config_find_free_gid (OobsGroupsConfig *config, gid_t gid_min, gid_t
    * we return the gid_max, which is the best we can do */
   return new_gid;
 }
+
+/**
+ * oobs_groups_config_set_fields:
+ * @config: An #OobsGroupsConfig.
+ * @fields: #OobsGroupFields to retrieve.
+ *
+ * Sets the optional fields retrieved for each group on the next
+ * updates. Leaving out fields that are not needed, like members
+ * when only group names and GIDs are used, makes updates cheaper.
+ * The fields that were left out are retrieved separately for each
+ * group the first time they are accessed or modified. The default
+ * is %OOBS_GROUP_FIELD_ALL.
+ *
+ * Note that each of those retrievals is a blocking round trip to the
+ * backends, so reading a left out field on all groups, or committing
+ * the configuration, costs one call per group. If that's expected,
+ * include the field here instead. Since it would block, asynchronous
+ * commits of incomplete groups fail with %OOBS_RESULT_MALFORMED_DATA.
+ **/
+void
+oobs_groups_config_set_fields (OobsGroupsConfig *config,
+			       OobsGroupFields   fields)
+{
+  OobsGroupsConfigPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_GROUPS_CONFIG (config));
+
+  priv = config->_priv;
+  priv->fields = fields & OOBS_GROUP_FIELD_ALL;
+}
@@ -80,6 +80,9 @@ gid_t       oobs_groups_config_find_free_gid (OobsGroupsConfig *config,
                                               gid_t             gid_min,
                                               gid_t             gid_max);
 
+void        oobs_groups_config_set_fields    (OobsGroupsConfig *config,
+                                              OobsGroupFields   fields);
+
 G_END_DECLS
 
 #endif /* __OOBS_GROUPS_CONFIG_H */
@@ -20,12 +20,14 @@
 
 #include <dbus/dbus.h>
 #include <glib-object.h>
+#include <string.h>
 #include "oobs-object.h"
 #include "oobs-object-private.h"
 #include "oobs-list.h"
 #include "oobs-list-private.h"
 #include "oobs-hostsconfig.h"
 #include "oobs-statichost.h"
+#include "oobs-statichost-private.h"
 #include "utils.h"
 
 /**
@@ -39,6 +41,13 @@
 #define OOBS_HOSTS_CONFIG_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_HOSTS_CONFIG, OobsHostsConfigPrivate))
 
 typedef struct _OobsHostsConfigPrivate OobsHostsConfigPrivate;
+typedef struct _OobsStaticHostEntry    OobsStaticHostEntry;
+
+struct _OobsStaticHostEntry
+{
+  OobsStaticHost *host;
+  OobsListIter    iter;
+};
 
 struct _OobsHostsConfigPrivate
 {
@@ -48,6 +57,21 @@ struct _OobsHostsConfigPrivate
   OobsList *static_hosts_list;
   GList *dns_list;
   GList *search_domains_list;
+
+  /* Indexes over static_hosts_list, the entries are owned by
+   * hosts_index, the other tables point to them. Aliases are
+   * stored in lowercase. They are rebuilt if either the list
+   * or any static host changed behind our back. */
+  GHashTable *hosts_index;
+  GHashTable *ip_index;
+  GHashTable *alias_index;
+
+  guint list_serial;
+  guint hosts_serial;
+  guint index_valid : 1;
+
+  /* whether any IP or alias was defined in more than one host */
+  guint index_shadowed : 1;
 };
 
 static void oobs_hosts_config_class_init (OobsHostsConfigClass *class);
@@ -84,6 +108,12 @@ oobs_hosts_config_init (OobsHostsConfig *config)
   priv = OOBS_HOSTS_CONFIG_GET_PRIVATE (config);
 
   priv->static_hosts_list = _oobs_list_new (OOBS_TYPE_STATIC_HOST);
+  priv->hosts_index = g_hash_table_new_full (NULL, NULL, NULL,
+                                             (GDestroyNotify) g_free);
+  priv->ip_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          (GDestroyNotify) g_free, NULL);
+  priv->alias_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             (GDestroyNotify) g_free, NULL);
   config->_priv = priv;
 }
 
@@ -139,6 +169,10 @@ oobs_hosts_config_finalize (GObject *object)
 
       if (priv->static_hosts_list)
 	g_object_unref (priv->static_hosts_list);
+
+      g_hash_table_destroy (priv->hosts_index);
+      g_hash_table_destroy (priv->ip_index);
+      g_hash_table_destroy (priv->alias_index);
     }
 
   if (G_OBJECT_CLASS (oobs_hosts_config_parent_class)->finalize)
@@ -278,6 +312,125 @@ oobs_hosts_config_commit (OobsObject *object)
   utils_create_dbus_array_from_string_list (priv->search_domains_list, message, &iter);
 }
 
+static void
+index_static_host_aliases (OobsHostsConfigPrivate *priv,
+                           OobsStaticHostEntry    *entry,
+                           GList                  *aliases)
+{
+  gchar *alias;
+
+  while (aliases)
+    {
+      alias = g_ascii_strdown (aliases->data, -1);
+
+      /* the first host defining an alias wins, as in /etc/hosts */
+      if (!g_hash_table_lookup (priv->alias_index, alias))
+        g_hash_table_insert (priv->alias_index, alias, entry);
+      else
+        {
+          priv->index_shadowed = TRUE;
+          g_free (alias);
+        }
+
+      aliases = aliases->next;
+    }
+}
+
+static void
+unindex_static_host_aliases (OobsHostsConfigPrivate *priv,
+                             OobsStaticHostEntry    *entry,
+                             GList                  *aliases)
+{
+  gchar *alias;
+
+  while (aliases)
+    {
+      alias = g_ascii_strdown (aliases->data, -1);
+
+      if (g_hash_table_lookup (priv->alias_index, alias) == entry)
+        g_hash_table_remove (priv->alias_index, alias);
+
+      g_free (alias);
+      aliases = aliases->next;
+    }
+}
+
+static OobsStaticHostEntry*
+index_static_host (OobsHostsConfigPrivate *priv,
+                   OobsStaticHost         *host,
+                   OobsListIter           *iter)
+{
+  OobsStaticHostEntry *entry;
+  const gchar *ip_address;
+  GList *aliases;
+
+  entry = g_new0 (OobsStaticHostEntry, 1);
+  entry->host = host;
+  entry->iter = *iter;
+  g_hash_table_insert (priv->hosts_index, host, entry);
+
+  ip_address = oobs_static_host_get_ip_address (host);
+
+  if (ip_address)
+    {
+      if (!g_hash_table_lookup (priv->ip_index, ip_address))
+        g_hash_table_insert (priv->ip_index, g_strdup (ip_address), entry);
+      else
+        priv->index_shadowed = TRUE;
+    }
+
+  aliases = oobs_static_host_get_aliases (host);
+  index_static_host_aliases (priv, entry, aliases);
+  g_list_free (aliases);
+
+  return entry;
+}
+
+/* Marks the current list contents as the indexed ones */
+static void
+stamp_index (OobsHostsConfigPrivate *priv)
+{
+  priv->list_serial = _oobs_list_get_serial (priv->static_hosts_list);
+  priv->hosts_serial = _oobs_static_host_get_serial ();
+}
+
+static void
+ensure_index (OobsHostsConfig *config)
+{
+  OobsHostsConfigPrivate *priv;
+  OobsListIter list_iter;
+  GObject *host;
+  gboolean valid;
+
+  priv = config->_priv;
+
+  if (priv->index_valid &&
+      priv->list_serial == _oobs_list_get_serial (priv->static_hosts_list) &&
+      priv->hosts_serial == _oobs_static_host_get_serial ())
+    return;
+
+  g_hash_table_remove_all (priv->ip_index);
+  g_hash_table_remove_all (priv->alias_index);
+  g_hash_table_remove_all (priv->hosts_index);
+  priv->index_shadowed = FALSE;
+
+  valid = oobs_list_get_iter_first (priv->static_hosts_list, &list_iter);
+
+  while (valid)
+    {
+      host = oobs_list_get (priv->static_hosts_list, &list_iter);
+
+      /* the list holds a reference */
+      index_static_host (priv, OOBS_STATIC_HOST (host), &list_iter);
+      g_object_unref (host);
+
+      valid = oobs_list_iter_next (priv->static_hosts_list, &list_iter);
+    }
+
+  stamp_index (priv);
+  priv->index_valid = TRUE;
+}
+
 /**
  * oobs_hosts_config_get:
  * 
@@ -503,3 +656,194 @@ oobs_hosts_config_set_search_domains (OobsHostsConfig *config,
 
   priv->search_domains_list = search_domains_list;
 }
+
+/**
+ * oobs_hosts_config_get_static_host_by_ip:
+ * @config: An #OobsHostsConfig.
+ * @ip_address: the IP address of the wanted static host.
+ *
+ * Gets the (first) static host defined for @ip_address. This is a
+ * convenience function to avoid walking manually over the static hosts
+ * list, lookups are done through an index.
+ *
+ * Return value: an #OobsStaticHost for @ip_address, or %NULL if no such
+ * static host exists. Don't forget to unref it when you're done.
+ **/
+OobsStaticHost*
+oobs_hosts_config_get_static_host_by_ip (OobsHostsConfig *config,
+                                         const gchar     *ip_address)
+{
+  OobsHostsConfigPrivate *priv;
+  OobsStaticHostEntry *entry;
+
+  g_return_val_if_fail (OOBS_IS_HOSTS_CONFIG (config), NULL);
+  g_return_val_if_fail (ip_address != NULL, NULL);
+
+  priv = config->_priv;
+  ensure_index (config);
+
+  entry = g_hash_table_lookup (priv->ip_index, ip_address);
+
+  return (entry) ? g_object_ref (entry->host) : NULL;
+}
+
+/**
+ * oobs_hosts_config_get_static_host_by_alias:
+ * @config: An #OobsHostsConfig.
+ * @alias: a host name, compared case insensitively.
+ *
+ * Gets the (first) static host that has @alias between its aliases.
+ * This is a convenience function to avoid walking manually over the
+ * static hosts list, lookups are done through an index.
+ *
+ * Return value: an #OobsStaticHost containing @alias, or %NULL if no such
+ * static host exists. Don't forget to unref it when you're done.
+ **/
+OobsStaticHost*
+oobs_hosts_config_get_static_host_by_alias (OobsHostsConfig *config,
+                                            const gchar     *alias)
+{
+  OobsHostsConfigPrivate *priv;
+  OobsStaticHostEntry *entry;
+  gchar *key;
+
+  g_return_val_if_fail (OOBS_IS_HOSTS_CONFIG (config), NULL);
+  g_return_val_if_fail (alias != NULL, NULL);
+
+  priv = config->_priv;
+  ensure_index (config);
+
+  key = g_ascii_strdown (alias, -1);
+  entry = g_hash_table_lookup (priv->alias_index, key);
+  g_free (key);
+
+  return (entry) ? g_object_ref (entry->host) : NULL;
+}
+
+/**
+ * oobs_hosts_config_set_static_host:
+ * @config: An #OobsHostsConfig.
+ * @ip_address: IP address for the static host.
+ * @aliases: #GList of aliases to @ip_address.
+ *
+ * Sets the aliases for @ip_address. If a static host already exists
+ * for @ip_address, its aliases are replaced, else a new #OobsStaticHost
+ * is appended to the static hosts list. As with oobs_static_host_set_aliases(),
+ * @aliases and its contents will be owned by the static host.
+ **/
+void
+oobs_hosts_config_set_static_host (OobsHostsConfig *config,
+                                   const gchar     *ip_address,
+                                   GList           *aliases)
+{
+  OobsHostsConfigPrivate *priv;
+  OobsStaticHostEntry *entry;
+  OobsStaticHost *host;
+  OobsListIter list_iter;
+  GList *old_aliases, *l;
+  gchar *alias;
+
+  g_return_if_fail (OOBS_IS_HOSTS_CONFIG (config));
+  g_return_if_fail (ip_address != NULL);
+
+  priv = config->_priv;
+  ensure_index (config);
+
+  entry = g_hash_table_lookup (priv->ip_index, ip_address);
+
+  if (entry)
+    {
+      old_aliases = oobs_static_host_get_aliases (entry->host);
+      unindex_static_host_aliases (priv, entry, old_aliases);
+      g_list_free (old_aliases);
+
+      /* a later host might define the same aliases */
+      if (priv->index_shadowed)
+        priv->index_valid = FALSE;
+
+      /* an alias already in another host might be ordered
+       * before or after this one, let a rebuild sort it out */
+      for (l = aliases; l && priv->index_valid; l = l->next)
+        {
+          alias = g_ascii_strdown (l->data, -1);
+
+          if (g_hash_table_lookup (priv->alias_index, alias))
+            priv->index_valid = FALSE;
+
+          g_free (alias);
+        }
+
+      oobs_static_host_set_aliases (entry->host, aliases);
+
+      if (priv->index_valid)
+        index_static_host_aliases (priv, entry, aliases);
+    }
+  else
+    {
+      host = oobs_static_host_new (ip_address, aliases);
+
+      oobs_list_append (priv->static_hosts_list, &list_iter);
+      oobs_list_set    (priv->static_hosts_list, &list_iter, G_OBJECT (host));
+
+      /* it's the last host, so it doesn't shadow any other */
+      index_static_host (priv, host, &list_iter);
+      g_object_unref (host);
+    }
+
+  stamp_index (priv);
+}
+
+/**
+ * oobs_hosts_config_remove_static_host:
+ * @config: An #OobsHostsConfig.
+ * @ip_address: IP address of the static host to remove.
+ *
+ * Removes the (first) static host defined for @ip_address from
+ * the static hosts list.
+ *
+ * Return value: %TRUE if a static host was removed.
+ **/
+gboolean
+oobs_hosts_config_remove_static_host (OobsHostsConfig *config,
+                                      const gchar     *ip_address)
+{
+  OobsHostsConfigPrivate *priv;
+  OobsStaticHostEntry *entry;
+  OobsStaticHost *host;
+  GList *aliases;
+  gboolean removed;
+
+  g_return_val_if_fail (OOBS_IS_HOSTS_CONFIG (config), FALSE);
+  g_return_val_if_fail (ip_address != NULL, FALSE);
+
+  priv = config->_priv;
+  ensure_index (config);
+
+  entry = g_hash_table_lookup (priv->ip_index, ip_address);
+
+  if (!entry)
+    return FALSE;
+
+  host = entry->host;
+
+  aliases = oobs_static_host_get_aliases (host);
+  unindex_static_host_aliases (priv, entry, aliases);
+  g_list_free (aliases);
+
+  g_hash_table_remove (priv->ip_index, ip_address);
+
+  removed = oobs_list_remove (priv->static_hosts_list, &entry->iter);
+
+  if (!removed)
+    priv->index_valid = FALSE;
+
+  g_hash_table_remove (priv->hosts_index, host);
+
+  /* another host might define the same IP or aliases */
+  if (priv->index_shadowed)
+    priv->index_valid = FALSE;
+
+  stamp_index (priv);
+
+  return removed;
+}
@@ -25,6 +25,7 @@ G_BEGIN_DECLS
 
 #include "oobs-object.h"
 #include "oobs-list.h"
+#include "oobs-statichost.h"
 
 #define OOBS_TYPE_HOSTS_CONFIG         (oobs_hosts_config_get_type ())
 #define OOBS_HOSTS_CONFIG(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), OOBS_TYPE_HOSTS_CONFIG, OobsHostsConfig))
@@ -68,6 +69,16 @@ void                   oobs_hosts_config_set_domainname (OobsHostsConfig *config
 
 OobsList*   oobs_hosts_config_get_static_hosts   (OobsHostsConfig *config);
 
+OobsStaticHost* oobs_hosts_config_get_static_host_by_ip    (OobsHostsConfig *config,
+                                                            const gchar     *ip_address);
+OobsStaticHost* oobs_hosts_config_get_static_host_by_alias (OobsHostsConfig *config,
+                                                            const gchar     *alias);
+void            oobs_hosts_config_set_static_host          (OobsHostsConfig *config,
+                                                            const gchar     *ip_address,
+                                                            GList           *aliases);
+gboolean        oobs_hosts_config_remove_static_host       (OobsHostsConfig *config,
+                                                            const gchar     *ip_address);
+
 GList*      oobs_hosts_config_get_dns_servers    (OobsHostsConfig *config);
 void        oobs_hosts_config_set_dns_servers    (OobsHostsConfig *config,
 						  GList           *dns_list);
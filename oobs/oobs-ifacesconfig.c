@@ -300,6 +300,168 @@ oobs_ifaces_config_finalize (GObject *object)
     (* G_OBJECT_CLASS (oobs_ifaces_config_parent_class)->finalize) (object);
 }
 
+/*
+ * Values of the interface structs exchanged with the backends, the
+ * tables below describe their layout for each interface type and the
+ * property each value maps to. Strings are owned.
+ */
+typedef struct {
+  gchar *dev;
+  gint   active;
+  gint   is_auto;
+
+  /* ethernet, wireless and irlan */
+  gchar *address;
+  gchar *netmask;
+  gchar *gateway;
+  gchar *essid;
+  gchar *key;
+  gchar *key_type;
+  gchar *config_method;
+
+  /* plip */
+  gchar *remote_address;
+
+  /* ppp */
+  gchar *connection_type;
+  gchar *phone_number;
+  gchar *phone_prefix;
+  gchar *device;
+  gint   volume;
+  gint   dial_type;
+  gchar *login;
+  gchar *password;
+  gint   default_gw;
+  gint   peer_dns;
+  gint   persistent;
+  gint   noauth;
+  gchar *apn;
+} IfaceData;
+
+static const UtilsField iface_fields[] = {
+  { UTILS_FIELD_STRING, NULL,     G_STRUCT_OFFSET (IfaceData, dev),     0, 0 },
+  { UTILS_FIELD_INT,    "active", G_STRUCT_OFFSET (IfaceData, active),  0, 0 },
+  { UTILS_FIELD_INT,    "auto",   G_STRUCT_OFFSET (IfaceData, is_auto), 0, 0 }
+};
+
+static const UtilsField ethernet_fields[] = {
+  /* deprecated */
+  { UTILS_FIELD_INT,    NULL,              UTILS_FIELD_NO_OFFSET,                0, 0 },
+  { UTILS_FIELD_STRING, "ip-address",      G_STRUCT_OFFSET (IfaceData, address), 0, 0 },
+  { UTILS_FIELD_STRING, "ip-mask",         G_STRUCT_OFFSET (IfaceData, netmask), 0, 0 },
+  /* FIXME: missing network and broadcast */
+  { UTILS_FIELD_STRING, NULL,              UTILS_FIELD_NO_OFFSET,                0, 0 },
+  { UTILS_FIELD_STRING, NULL,              UTILS_FIELD_NO_OFFSET,                0, 0 },
+  { UTILS_FIELD_STRING, "gateway-address", G_STRUCT_OFFSET (IfaceData, gateway), 0, 0 }
+};
+
+static const UtilsField wireless_fields[] = {
+  { UTILS_FIELD_STRING, "essid",    G_STRUCT_OFFSET (IfaceData, essid),    0, 0 },
+  /* deprecated */
+  { UTILS_FIELD_INT,    NULL,       UTILS_FIELD_NO_OFFSET,                 0, 0 },
+  { UTILS_FIELD_STRING, "key",      G_STRUCT_OFFSET (IfaceData, key),      0, 0 },
+  { UTILS_FIELD_STRING, "key-type", G_STRUCT_OFFSET (IfaceData, key_type), 0, 0 }
+};
+
+static const UtilsField config_method_fields[] = {
+  { UTILS_FIELD_STRING, "config-method", G_STRUCT_OFFSET (IfaceData, config_method), 0, 0 }
+};
+
+static const UtilsField plip_fields[] = {
+  { UTILS_FIELD_STRING, "address",        G_STRUCT_OFFSET (IfaceData, address),        0, 0 },
+  { UTILS_FIELD_STRING, "remote-address", G_STRUCT_OFFSET (IfaceData, remote_address), 0, 0 }
+};
+
+static const UtilsField ppp_fields[] = {
+  { UTILS_FIELD_STRING, "connection-type", G_STRUCT_OFFSET (IfaceData, connection_type), 0, 0 },
+  { UTILS_FIELD_STRING, "phone-number",    G_STRUCT_OFFSET (IfaceData, phone_number),    0, 0 },
+  { UTILS_FIELD_STRING, "phone-prefix",    G_STRUCT_OFFSET (IfaceData, phone_prefix),    0, 0 },
+  /* either the serial port or the pppoe ethernet interface */
+  { UTILS_FIELD_STRING, NULL,              G_STRUCT_OFFSET (IfaceData, device),          0, 0 },
+  { UTILS_FIELD_INT,    "volume",          G_STRUCT_OFFSET (IfaceData, volume),          0, 0 },
+  { UTILS_FIELD_INT,    "dial-type",       G_STRUCT_OFFSET (IfaceData, dial_type),       0, 0 },
+  { UTILS_FIELD_STRING, "login",           G_STRUCT_OFFSET (IfaceData, login),           0, 0 },
+  { UTILS_FIELD_STRING, "password",        G_STRUCT_OFFSET (IfaceData, password),        0, 0 },
+  { UTILS_FIELD_INT,    "default-gateway", G_STRUCT_OFFSET (IfaceData, default_gw),      0, 0 },
+  { UTILS_FIELD_INT,    "use-peer-dns",    G_STRUCT_OFFSET (IfaceData, peer_dns),        0, 0 },
+  { UTILS_FIELD_INT,    "persistent",      G_STRUCT_OFFSET (IfaceData, persistent),      0, 0 },
+  { UTILS_FIELD_INT,    "peer-noauth",     G_STRUCT_OFFSET (IfaceData, noauth),          0, 0 },
+  { UTILS_FIELD_STRING, "apn",             G_STRUCT_OFFSET (IfaceData, apn),             0, 0 }
+};
+
+static void
+free_iface_data (IfaceData *data)
+{
+  g_free (data->dev);
+  g_free (data->address);
+  g_free (data->netmask);
+  g_free (data->gateway);
+  g_free (data->essid);
+  g_free (data->key);
+  g_free (data->key_type);
+  g_free (data->config_method);
+  g_free (data->remote_address);
+  g_free (data->connection_type);
+  g_free (data->phone_number);
+  g_free (data->phone_prefix);
+  g_free (data->device);
+  g_free (data->login);
+  g_free (data->password);
+  g_free (data->apn);
+}
+
+/* Sets the properties named in the table from data */
+static void
+set_iface_properties (GObject          *iface,
+		      const UtilsField *fields,
+		      guint             n_fields,
+		      IfaceData        *data)
+{
+  gpointer location;
+  guint i;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      if (!fields[i].property ||
+	  fields[i].offset == UTILS_FIELD_NO_OFFSET)
+	continue;
+
+      location = G_STRUCT_MEMBER_P (data, fields[i].offset);
+
+      if (fields[i].type == UTILS_FIELD_STRING)
+	g_object_set (iface, fields[i].property, *(gchar **) location, NULL);
+      else
+	g_object_set (iface, fields[i].property, *(gint *) location, NULL);
+    }
+}
+
+/* Fills data from the properties named in the table, strings
+ * are left empty if the interface isn't configured */
+static void
+get_iface_properties (GObject          *iface,
+		      const UtilsField *fields,
+		      guint             n_fields,
+		      gboolean          configured,
+		      IfaceData        *data)
+{
+  gpointer location;
+  guint i;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      if (!fields[i].property ||
+	  fields[i].offset == UTILS_FIELD_NO_OFFSET)
+	continue;
+
+      location = G_STRUCT_MEMBER_P (data, fields[i].offset);
+
+      if (fields[i].type != UTILS_FIELD_STRING)
+	g_object_get (iface, fields[i].property, (gint *) location, NULL);
+      else if (configured)
+	g_object_get (iface, fields[i].property, (gchar **) location, NULL);
+    }
+}
+
 static GObject*
 create_iface_from_message (DBusMessage     *message,
 			   DBusMessageIter *iter,
@@ -308,152 +470,77 @@ create_iface_from_message (DBusMessage     *message,
 {
   GObject *iface = NULL; /* shut up gcc */
   DBusMessageIter struct_iter;
-  const gchar *dev;
-  gboolean active, is_auto;
+  IfaceData data = { 0, };
 
   dbus_message_iter_recurse (iter, &struct_iter);
 
-  dev = utils_get_string (&struct_iter);
-  active = utils_get_int (&struct_iter);
-  is_auto = utils_get_int (&struct_iter);
+  utils_decode_fields (&struct_iter, iface_fields, G_N_ELEMENTS (iface_fields), 0, &data, NULL);
 
   switch (type)
     {
     case OOBS_IFACE_TYPE_ETHERNET:
-      iface = g_object_new (OOBS_TYPE_IFACE_ETHERNET, "device", dev, NULL);
+      iface = g_object_new (OOBS_TYPE_IFACE_ETHERNET, "device", data.dev, NULL);
       break;
     case OOBS_IFACE_TYPE_WIRELESS:
-      iface = g_object_new (OOBS_TYPE_IFACE_WIRELESS, "device", dev, NULL);
+      iface = g_object_new (OOBS_TYPE_IFACE_WIRELESS, "device", data.dev, NULL);
       break;
     case OOBS_IFACE_TYPE_IRLAN:
-      iface = g_object_new (OOBS_TYPE_IFACE_IRLAN, "device", dev, NULL);
+      iface = g_object_new (OOBS_TYPE_IFACE_IRLAN, "device", data.dev, NULL);
       break;
     case OOBS_IFACE_TYPE_PLIP:
-      iface = g_object_new (OOBS_TYPE_IFACE_PLIP, "device", dev, NULL);
+      iface = g_object_new (OOBS_TYPE_IFACE_PLIP, "device", data.dev, NULL);
       break;
     case OOBS_IFACE_TYPE_PPP:
-      iface = g_object_new (OOBS_TYPE_IFACE_PPP, "device", dev, NULL);
+      iface = g_object_new (OOBS_TYPE_IFACE_PPP, "device", data.dev, NULL);
       break;
     }
 
+  set_iface_properties (iface, iface_fields, G_N_ELEMENTS (iface_fields), &data);
+
   if (OOBS_IS_IFACE_ETHERNET (iface))
     {
-      const gchar *address, *netmask, *gateway, *config_method;
-
-      /* This value is deprecated */
-      dbus_message_iter_next (&struct_iter);
-
-      address = utils_get_string (&struct_iter);
-      netmask = utils_get_string (&struct_iter);
-
-      /* FIXME: missing network and broadcast */
-      dbus_message_iter_next (&struct_iter);
-      dbus_message_iter_next (&struct_iter);
-
-      gateway = utils_get_string (&struct_iter);
-
-      g_object_set (iface,
-		    "auto", is_auto,
-		    "active", active,
-		    "ip-address", address,
-		    "ip-mask", netmask,
-		    "gateway-address", gateway,
-		    NULL);
+      utils_decode_fields (&struct_iter, ethernet_fields, G_N_ELEMENTS (ethernet_fields), 0, &data, NULL);
+      set_iface_properties (iface, ethernet_fields, G_N_ELEMENTS (ethernet_fields), &data);
 
-      if (type == OOBS_IFACE_TYPE_WIRELESS)
+      if (OOBS_IS_IFACE_WIRELESS (iface))
 	{
-	  const gchar *essid, *key, *key_type;
-
-	  essid = utils_get_string (&struct_iter);
-
-	  /* This value is deprecated */
-	  dbus_message_iter_next (&struct_iter);
-
-	  key = utils_get_string (&struct_iter);
-	  key_type = utils_get_string (&struct_iter);
-
-	  g_object_set (iface,
-			"essid", essid,
-			"key_type", key_type,
-			"key", key,
-			NULL);
+	  utils_decode_fields (&struct_iter, wireless_fields, G_N_ELEMENTS (wireless_fields), 0, &data, NULL);
+	  set_iface_properties (iface, wireless_fields, G_N_ELEMENTS (wireless_fields), &data);
 	}
 
-      config_method = utils_get_string (&struct_iter);
-      g_object_set (iface, "config-method", config_method, NULL);
+      utils_decode_fields (&struct_iter, config_method_fields, G_N_ELEMENTS (config_method_fields), 0, &data, NULL);
+      set_iface_properties (iface, config_method_fields, G_N_ELEMENTS (config_method_fields), &data);
     }
   else if (OOBS_IS_IFACE_PLIP (iface))
     {
-      const gchar *address, *remote_address;
-
-      address = utils_get_string (&struct_iter);
-      remote_address = utils_get_string (&struct_iter);
-
-      g_object_set (iface,
-		    "auto", is_auto,
-		    "active", active,
-		    "address", address,
-		    "remote-address", remote_address,
-		    NULL);
+      utils_decode_fields (&struct_iter, plip_fields, G_N_ELEMENTS (plip_fields), 0, &data, NULL);
+      set_iface_properties (iface, plip_fields, G_N_ELEMENTS (plip_fields), &data);
     }
   else if (OOBS_IS_IFACE_PPP (iface))
     {
-      const gchar *phone_number, *phone_prefix, *login, *password;
-      const gchar *device, *connection_type, *apn;
-      gboolean default_gw, peer_dns, persistent, noauth;
-      gint volume, dial_type;
-
-      connection_type = utils_get_string (&struct_iter);
-
-      phone_number = utils_get_string (&struct_iter);
-      phone_prefix = utils_get_string (&struct_iter);
-
-      device = utils_get_string (&struct_iter);
-      volume = utils_get_int (&struct_iter);
-      dial_type = utils_get_int (&struct_iter);
+      utils_decode_fields (&struct_iter, ppp_fields, G_N_ELEMENTS (ppp_fields), 0, &data, NULL);
 
-      login = utils_get_string (&struct_iter);
-      password = utils_get_string (&struct_iter);
-
-      default_gw = utils_get_int (&struct_iter);
-      peer_dns = utils_get_int (&struct_iter);
-      persistent = utils_get_int (&struct_iter);
-      noauth = utils_get_int (&struct_iter);
-
-      apn = utils_get_string (&struct_iter);
-
-      if (connection_type &&
-	  strcmp (connection_type, "pppoe") == 0)
+      if (data.connection_type &&
+	  strcmp (data.connection_type, "pppoe") == 0)
 	{
-	  OobsIface *ethernet;
+	  OobsIface *ethernet = NULL;
 
 	  /* in pppoe configuration, the device
 	   * contains the ethernet interface name
 	   */
-	  ethernet = g_hash_table_lookup (ifaces, device);
+	  if (data.device)
+	    ethernet = g_hash_table_lookup (ifaces, data.device);
+
 	  g_object_set (iface, "ethernet", ethernet, NULL);
 	}
       else
-	g_object_set (iface, "serial-port", device, NULL);
-
-      g_object_set (iface,
-		    "auto", is_auto,
-		    "active", active,
-		    "connection-type", connection_type,
-		    "login", login,
-		    "password", password,
-		    "phone-number", phone_number,
-		    "phone-prefix", phone_prefix,
-		    "default-gateway", default_gw,
-		    "use-peer-dns", peer_dns,
-		    "persistent", persistent,
-		    "peer-noauth", noauth,
-		    "volume", volume,
-		    "dial-type", dial_type,
-		    "apn", apn,
-		    NULL);
+	g_object_set (iface, "serial-port", data.device, NULL);
+
+      set_iface_properties (iface, ppp_fields, G_N_ELEMENTS (ppp_fields), &data);
     }
 
+  free_iface_data (&data);
+
   /* FIXME: missing properties */
   return iface;
 }
@@ -523,153 +610,69 @@ create_dbus_struct_from_iface (DBusMessage     *message,
 			       OobsIface       *iface)
 {
   DBusMessageIter iter;
-  gchar *dev;
-  gboolean configured, active, is_auto;
+  IfaceData data = { 0, };
+  gboolean configured;
 
   g_object_get (G_OBJECT (iface),
-		"device", &dev,
+		"device", &data.dev,
 		"configured", &configured,
-		"auto", &is_auto,
-		"active", &active,
 		NULL);
 
-  dbus_message_iter_open_container (array_iter, DBUS_TYPE_STRUCT, NULL, &iter);
+  get_iface_properties (G_OBJECT (iface), iface_fields, G_N_ELEMENTS (iface_fields), TRUE, &data);
 
-  utils_append_string (&iter, dev);
-  utils_append_int (&iter, active);
-  utils_append_int (&iter, is_auto);
+  dbus_message_iter_open_container (array_iter, DBUS_TYPE_STRUCT, NULL, &iter);
+  utils_encode_fields (&iter, iface_fields, G_N_ELEMENTS (iface_fields), &data);
 
   if (OOBS_IS_IFACE_ETHERNET (iface))
     {
-      gchar *address, *netmask, *gateway, *config_method;
-
-      g_object_get (G_OBJECT (iface),
-		    "ip-address", &address,
-		    "ip-mask", &netmask,
-		    "gateway-address", &gateway,
-		    "config-method", &config_method,
-		    NULL);
-
-      /* This field is deprecated */
-      utils_append_int (&iter, 0);
-      utils_append_string (&iter, (configured) ? address : NULL);
-      utils_append_string (&iter, (configured) ? netmask : NULL);
-
-      /* FIXME */
-      utils_append_string (&iter, NULL);
-      utils_append_string (&iter, NULL);
-
-      utils_append_string (&iter, (configured) ? gateway : NULL);
+      get_iface_properties (G_OBJECT (iface), ethernet_fields, G_N_ELEMENTS (ethernet_fields), configured, &data);
+      utils_encode_fields (&iter, ethernet_fields, G_N_ELEMENTS (ethernet_fields), &data);
 
       if (OOBS_IS_IFACE_WIRELESS (iface))
 	{
-	  gchar *essid, *key, *key_type;
-
-	  g_object_get (G_OBJECT (iface),
-			"essid", &essid,
-			"key-type", &key_type,
-			"key", &key,
-			NULL);
-
-	  utils_append_string (&iter, (configured) ? essid : NULL);
-
-	  /* This field is deprecated */
-	  utils_append_int (&iter, 0);
-	  utils_append_string (&iter, (configured) ? key : NULL);
-	  utils_append_string (&iter, (configured) ? key_type : NULL);
-
-	  g_free (key_type);
-	  g_free (essid);
-	  g_free (key);
+	  get_iface_properties (G_OBJECT (iface), wireless_fields, G_N_ELEMENTS (wireless_fields), configured, &data);
+	  utils_encode_fields (&iter, wireless_fields, G_N_ELEMENTS (wireless_fields), &data);
 	}
 
-      utils_append_string (&iter, (configured) ? config_method : NULL);
-
-      g_free (address);
-      g_free (netmask);
-      g_free (gateway);
-      g_free (config_method);
+      get_iface_properties (G_OBJECT (iface), config_method_fields, G_N_ELEMENTS (config_method_fields), configured, &data);
+      utils_encode_fields (&iter, config_method_fields, G_N_ELEMENTS (config_method_fields), &data);
     }
   else if (OOBS_IS_IFACE_PLIP (iface))
     {
-      gchar *address, *remote_address;
-
-      g_object_get (G_OBJECT (iface),
-		    "address", &address,
-		    "remote-address", &remote_address,
-		    NULL);
-
-      utils_append_string (&iter, (configured) ? address : NULL);
-      utils_append_string (&iter, (configured) ? remote_address : NULL);
-
-      g_free (address);
-      g_free (remote_address);
+      get_iface_properties (G_OBJECT (iface), plip_fields, G_N_ELEMENTS (plip_fields), configured, &data);
+      utils_encode_fields (&iter, plip_fields, G_N_ELEMENTS (plip_fields), &data);
     }
   else if (OOBS_IS_IFACE_PPP (iface))
     {
-      gchar *phone_number, *prefix, *login, *password;
-      gchar *serial_port, *connection_type, *apn;
-      gboolean default_gw, peer_dns, persistent, noauth;
-      gint volume, dial_type;
       OobsIface *ethernet;
+      gchar *connection_type;
+
+      get_iface_properties (G_OBJECT (iface), ppp_fields, G_N_ELEMENTS (ppp_fields), configured, &data);
 
       g_object_get (G_OBJECT (iface),
 		    "connection-type", &connection_type,
-		    "login", &login,
-		    "password", &password,
-		    "phone-number", &phone_number,
-		    "phone-prefix", &prefix,
-		    "default-gateway", &default_gw,
-		    "use-peer-dns", &peer_dns,
-		    "persistent", &persistent,
-		    "peer-noauth", &noauth,
-		    "serial-port", &serial_port,
-		    "volume", &volume,
-		    "dial-type", &dial_type,
 		    "ethernet", &ethernet,
-		    "apn", &apn,
 		    NULL);
 
-      utils_append_string (&iter, (configured) ? connection_type : NULL);
-
-      utils_append_string (&iter, (configured) ? phone_number : NULL);
-      utils_append_string (&iter, (configured) ? prefix : NULL);
-
       if (connection_type &&
 	  strcmp (connection_type, "pppoe") == 0)
 	{
 	  if (ethernet)
-	    utils_append_string (&iter, oobs_iface_get_device_name (ethernet));
-	  else
-	    utils_append_string (&iter, NULL);
+	    data.device = g_strdup (oobs_iface_get_device_name (ethernet));
 	}
-      else
-	utils_append_string (&iter, (configured) ? serial_port : NULL);
-
-      utils_append_int (&iter, volume);
-      utils_append_int (&iter, dial_type);
+      else if (configured)
+	g_object_get (G_OBJECT (iface), "serial-port", &data.device, NULL);
 
-      utils_append_string (&iter, (configured) ? login : NULL);
-      utils_append_string (&iter, (configured) ? password : NULL);
-      utils_append_int (&iter, default_gw);
-      utils_append_int (&iter, peer_dns);
-      utils_append_int (&iter, persistent);
-      utils_append_int (&iter, noauth);
-      utils_append_string (&iter, (configured) ? apn : NULL);
+      utils_encode_fields (&iter, ppp_fields, G_N_ELEMENTS (ppp_fields), &data);
 
       if (ethernet)
 	g_object_unref (ethernet);
 
       g_free (connection_type);
-      g_free (phone_number);
-      g_free (prefix);
-      g_free (login);
-      g_free (password);
-      g_free (serial_port);
     }
 
   dbus_message_iter_close_container (array_iter, &iter);
-  g_free (dev);
+  free_iface_data (&data);
 }
 
 static void
@@ -28,6 +28,9 @@ G_BEGIN_DECLS
 OobsList*   _oobs_list_new        (const GType contained_type);
 void        _oobs_list_set_locked (OobsList   *list,
                                    gboolean    locked);
+guint       _oobs_list_get_serial (OobsList   *list);
+guint       _oobs_list_remove_objects (OobsList   *list,
+                                       GHashTable *objects);
 
 
 G_END_DECLS
@@ -42,6 +42,9 @@ struct _OobsListPrivate
   GList *list;
   guint  stamp;
 
+  /* changes on every modification, see _oobs_list_get_serial() */
+  guint  serial;
+
   GType  contained_type;
   gboolean locked;
 };
@@ -179,6 +182,57 @@ _oobs_list_new (const GType contained_type)
 		       NULL);
 }
 
+/*
+ * Returns a number that changes whenever elements are added, removed
+ * or set in the list, so other objects can tell whether any index
+ * they keep over the list contents is still valid.
+ */
+guint
+_oobs_list_get_serial (OobsList *list)
+{
+  OobsListPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_LIST (list), 0);
+
+  priv = list->_priv;
+  return priv->serial;
+}
+
+/*
+ * Removes from the list all the elements contained in the @objects
+ * set in a single pass, returns the number of removed elements.
+ */
+guint
+_oobs_list_remove_objects (OobsList   *list,
+                           GHashTable *objects)
+{
+  OobsListPrivate *priv;
+  GList *l, *next;
+  guint n_removed = 0;
+
+  g_return_val_if_fail (OOBS_IS_LIST (list), 0);
+
+  priv = list->_priv;
+  g_return_val_if_fail (priv->locked != TRUE, 0);
+
+  for (l = priv->list; l; l = next)
+    {
+      next = l->next;
+
+      if (!g_hash_table_lookup (objects, l->data))
+        continue;
+
+      g_object_unref (l->data);
+      priv->list = g_list_delete_link (priv->list, l);
+      n_removed++;
+    }
+
+  if (n_removed > 0)
+    priv->serial++;
+
+  return n_removed;
+}
+
 void
 _oobs_list_set_locked (OobsList *list, gboolean locked)
 {
@@ -291,6 +345,7 @@ oobs_list_remove (OobsList *list, OobsListIter *iter)
 
   g_object_unref (data->data);
   priv->list = g_list_delete_link (priv->list, data);
+  priv->serial++;
 
   iter->data = next;
 
@@ -326,6 +381,7 @@ oobs_list_append (OobsList *list, OobsListIter *iter)
     priv->stamp++;
 
   priv->list = g_list_append (priv->list, NULL);
+  priv->serial++;
 
   iter->data = g_list_last (priv->list);
   iter->stamp = priv->stamp;
@@ -360,6 +416,7 @@ oobs_list_prepend (OobsList *list, OobsListIter *iter)
     priv->stamp++;
 
   priv->list = g_list_prepend (priv->list, NULL);
+  priv->serial++;
 
   iter->data = priv->list;
   iter->stamp = priv->stamp;
@@ -406,6 +463,7 @@ oobs_list_insert_after (OobsList     *list,
   node->next = anchor_node->next;
   anchor_node->next = node;
   node->prev = anchor_node;
+  priv->serial++;
 
   iter->stamp = priv->stamp;
   iter->data  = node;
@@ -455,6 +513,7 @@ oobs_list_insert_before (OobsList     *list,
   node->prev = anchor_node->prev;
   anchor_node->prev = node;
   node->next = anchor_node;
+  priv->serial++;
 
   iter->stamp = priv->stamp;
   iter->data  = node;
@@ -549,6 +608,7 @@ oobs_list_set (OobsList     *list,
     return;
 
   node->data = g_object_ref (data);
+  priv->serial++;
 }
 
 /**
@@ -577,6 +637,7 @@ oobs_list_clear (OobsList *list)
       g_list_foreach (priv->list, (GFunc) g_object_unref, NULL);
       g_list_free    (priv->list);
       priv->list = NULL;
+      priv->serial++;
     }
 }
 
@@ -18,9 +18,16 @@
  * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
  */
 
+#include "config.h"
 #include <dbus/dbus.h>
 #include <glib-object.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
 
 #include "oobs-object.h"
 #include "oobs-object-private.h"
@@ -42,12 +49,69 @@
 #define OOBS_NFS_CONFIG_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_NFS_CONFIG, OobsNFSConfigPrivate))
 
 typedef struct _OobsNFSConfigPrivate OobsNFSConfigPrivate;
+typedef struct _OobsNFSAclRule       OobsNFSAclRule;
+typedef struct _OobsNFSAclTrieNode   OobsNFSAclTrieNode;
+typedef struct _OobsNFSAclWildcard   OobsNFSAclWildcard;
 
 struct _OobsNFSConfigPrivate
 {
   OobsList *shares_list;
 };
 
+/* Client specification kinds, in the order they take
+ * precedence when a client matches several of them,
+ * as described in exports(5) */
+enum {
+  RANK_HOST,
+  RANK_SUBNET,
+  RANK_WILDCARD,
+  RANK_NETGROUP,
+  RANK_ANONYMOUS
+};
+
+struct _OobsNFSAclRule
+{
+  guint share;
+  guint index;
+  guint rank : 4;
+  guint read_only : 1;
+};
+
+struct _OobsNFSAclTrieNode
+{
+  OobsNFSAclTrieNode *child[2];
+  GSList *rules;
+};
+
+struct _OobsNFSAclWildcard
+{
+  GPatternSpec *pattern;
+  GSList *rules;
+};
+
+struct _OobsNFSAclMatcher
+{
+  GPtrArray *shares;
+
+  /* lowercase host name or normalized IP address -> rules */
+  GHashTable *hosts;
+
+  /* prefix tries over the address bits */
+  OobsNFSAclTrieNode *ipv4;
+  OobsNFSAclTrieNode *ipv6;
+
+  /* pattern -> OobsNFSAclWildcard */
+  GHashTable *wildcards;
+
+  /* netgroup name -> rules */
+  GHashTable *netgroups;
+
+  GSList *anonymous;
+
+  /* all the rules, so they can be freed */
+  GSList *rules;
+};
+
 static void oobs_nfs_config_class_init (OobsNFSConfigClass *class);
 static void oobs_nfs_config_init       (OobsNFSConfig      *config);
 static void oobs_nfs_config_finalize   (GObject            *object);
@@ -284,3 +348,444 @@ oobs_nfs_config_get_shares (OobsNFSConfig *config)
 
   return priv->shares_list;
 }
+
+static void
+free_rules_list (GSList *rules)
+{
+  g_slist_free (rules);
+}
+
+static void
+free_wildcard (OobsNFSAclWildcard *wildcard)
+{
+  g_pattern_spec_free (wildcard->pattern);
+  g_slist_free (wildcard->rules);
+  g_free (wildcard);
+}
+
+static void
+free_trie (OobsNFSAclTrieNode *node)
+{
+  if (!node)
+    return;
+
+  free_trie (node->child[0]);
+  free_trie (node->child[1]);
+  g_slist_free (node->rules);
+  g_free (node);
+}
+
+static void
+add_rule_to_table (GHashTable     *table,
+                   const gchar    *key,
+                   OobsNFSAclRule *rule)
+{
+  GSList *rules;
+
+  rules = g_hash_table_lookup (table, key);
+
+  /* the list head doesn't change on append */
+  if (rules)
+    rules = g_slist_append (rules, rule);
+  else
+    g_hash_table_insert (table, g_strdup (key), g_slist_append (NULL, rule));
+}
+
+static void
+add_rule_to_trie (OobsNFSAclTrieNode **root,
+                  const guchar        *address,
+                  guint                prefix_len,
+                  OobsNFSAclRule      *rule)
+{
+  OobsNFSAclTrieNode *node;
+  guint i, bit;
+
+  if (!*root)
+    *root = g_new0 (OobsNFSAclTrieNode, 1);
+
+  node = *root;
+
+  for (i = 0; i < prefix_len; i++)
+    {
+      bit = (address[i / 8] >> (7 - (i % 8))) & 1;
+
+      if (!node->child[bit])
+        node->child[bit] = g_new0 (OobsNFSAclTrieNode, 1);
+
+      node = node->child[bit];
+    }
+
+  node->rules = g_slist_append (node->rules, rule);
+}
+
+/* Parses a prefix length or a dotted netmask, returns -1 if invalid */
+static gint
+parse_netmask (const gchar *mask,
+               gint         max_len)
+{
+  struct in_addr addr;
+  guint32 bits;
+  gchar *end;
+  glong len;
+  gint i;
+
+  if (!*mask)
+    return -1;
+
+  if (strspn (mask, "0123456789") == strlen (mask))
+    {
+      len = strtol (mask, &end, 10);
+      return (len <= max_len) ? (gint) len : -1;
+    }
+
+  if (max_len != 32 || inet_pton (AF_INET, mask, &addr) != 1)
+    return -1;
+
+  bits = ntohl (addr.s_addr);
+
+  for (i = 0; i < 32 && (bits & (1U << (31 - i))); i++)
+    ;
+
+  /* non contiguous masks aren't supported */
+  if (i < 32 && (bits << i) != 0)
+    return -1;
+
+  return i;
+}
+
+/* Returns the normalized string form of an IP address, or NULL */
+static gchar *
+normalize_address (const gchar *str)
+{
+  gchar buf[INET6_ADDRSTRLEN];
+  guchar addr[sizeof (struct in6_addr)];
+
+  if (inet_pton (AF_INET, str, addr) == 1)
+    return g_strdup (inet_ntop (AF_INET, addr, buf, sizeof (buf)));
+
+  if (inet_pton (AF_INET6, str, addr) == 1)
+    return g_strdup (inet_ntop (AF_INET6, addr, buf, sizeof (buf)));
+
+  return NULL;
+}
+
+static void
+compile_acl_element (OobsNFSAclMatcher   *matcher,
+                     OobsShareAclElement *element,
+                     guint                share,
+                     guint                index)
+{
+  OobsNFSAclWildcard *wildcard;
+  OobsNFSAclRule *rule;
+  guchar addr[sizeof (struct in6_addr)];
+  gchar *pattern, *slash, *normalized;
+  gint prefix_len;
+
+  if (!element->element || !*element->element)
+    return;
+
+  rule = g_new0 (OobsNFSAclRule, 1);
+  rule->share = share;
+  rule->index = index;
+  rule->read_only = (element->read_only != FALSE);
+  matcher->rules = g_slist_prepend (matcher->rules, rule);
+
+  pattern = g_ascii_strdown (element->element, -1);
+
+  if (pattern[0] == '@')
+    {
+      rule->rank = RANK_NETGROUP;
+      /* netgroup names are case sensitive */
+      add_rule_to_table (matcher->netgroups, element->element + 1, rule);
+    }
+  else if (strcmp (pattern, "*") == 0)
+    {
+      rule->rank = RANK_ANONYMOUS;
+      matcher->anonymous = g_slist_append (matcher->anonymous, rule);
+    }
+  else if ((slash = strchr (pattern, '/')) != NULL)
+    {
+      rule->rank = RANK_SUBNET;
+      *slash = '\0';
+
+      if (inet_pton (AF_INET, pattern, addr) == 1 &&
+	  (prefix_len = parse_netmask (slash + 1, 32)) >= 0)
+	add_rule_to_trie (&matcher->ipv4, addr, prefix_len, rule);
+      else if (inet_pton (AF_INET6, pattern, addr) == 1 &&
+	       (prefix_len = parse_netmask (slash + 1, 128)) >= 0)
+	add_rule_to_trie (&matcher->ipv6, addr, prefix_len, rule);
+
+      /* anything else can't match any client */
+    }
+  else if (strpbrk (pattern, "*?"))
+    {
+      rule->rank = RANK_WILDCARD;
+      wildcard = g_hash_table_lookup (matcher->wildcards, pattern);
+
+      if (!wildcard)
+	{
+	  wildcard = g_new0 (OobsNFSAclWildcard, 1);
+	  wildcard->pattern = g_pattern_spec_new (pattern);
+	  g_hash_table_insert (matcher->wildcards, g_strdup (pattern), wildcard);
+	}
+
+      wildcard->rules = g_slist_append (wildcard->rules, rule);
+    }
+  else
+    {
+      rule->rank = RANK_HOST;
+      normalized = normalize_address (pattern);
+      add_rule_to_table (matcher->hosts, (normalized) ? normalized : pattern, rule);
+      g_free (normalized);
+    }
+
+  g_free (pattern);
+}
+
+/**
+ * oobs_nfs_config_compile_acl_matcher:
+ * @config: An #OobsNFSConfig.
+ *
+ * Compiles the ACLs of all the shares in @config into a matcher
+ * that can be used to evaluate which shares a given client can
+ * access, see oobs_nfs_acl_matcher_get_shares(). Host names and
+ * IP addresses are hashed, networks (in the form "address/mask")
+ * are stored in a prefix tree, and wildcards are compiled once
+ * per distinct pattern.
+ *
+ * The matcher is a snapshot of the current configuration, it has to
+ * be compiled again if the shares list or their ACLs change.
+ *
+ * Return Value: A newly allocated #OobsNFSAclMatcher, free it with
+ *               oobs_nfs_acl_matcher_free().
+ **/
+OobsNFSAclMatcher*
+oobs_nfs_config_compile_acl_matcher (OobsNFSConfig *config)
+{
+  OobsNFSConfigPrivate *priv;
+  OobsNFSAclMatcher *matcher;
+  OobsListIter list_iter;
+  GObject *share;
+  GSList *acl, *elem;
+  gboolean valid;
+  guint index;
+
+  g_return_val_if_fail (OOBS_IS_NFS_CONFIG (config), NULL);
+
+  priv = config->_priv;
+
+  matcher = g_new0 (OobsNFSAclMatcher, 1);
+  matcher->shares = g_ptr_array_new ();
+  matcher->hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          (GDestroyNotify) g_free,
+                                          (GDestroyNotify) free_rules_list);
+  matcher->wildcards = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              (GDestroyNotify) g_free,
+                                              (GDestroyNotify) free_wildcard);
+  matcher->netgroups = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              (GDestroyNotify) g_free,
+                                              (GDestroyNotify) free_rules_list);
+
+  valid = oobs_list_get_iter_first (priv->shares_list, &list_iter);
+
+  while (valid)
+    {
+      share = oobs_list_get (priv->shares_list, &list_iter);
+      acl = oobs_share_nfs_get_acl (OOBS_SHARE_NFS (share));
+
+      for (elem = acl, index = 0; elem; elem = elem->next, index++)
+	compile_acl_element (matcher, elem->data, matcher->shares->len, index);
+
+      /* the matcher keeps the reference */
+      g_ptr_array_add (matcher->shares, share);
+      g_slist_free (acl);
+
+      valid = oobs_list_iter_next (priv->shares_list, &list_iter);
+    }
+
+  return matcher;
+}
+
+/**
+ * oobs_nfs_acl_matcher_free:
+ * @matcher: An #OobsNFSAclMatcher.
+ *
+ * Frees a matcher created by oobs_nfs_config_compile_acl_matcher().
+ **/
+void
+oobs_nfs_acl_matcher_free (OobsNFSAclMatcher *matcher)
+{
+  g_return_if_fail (matcher != NULL);
+
+  g_ptr_array_foreach (matcher->shares, (GFunc) g_object_unref, NULL);
+  g_ptr_array_free (matcher->shares, TRUE);
+
+  g_hash_table_destroy (matcher->hosts);
+  g_hash_table_destroy (matcher->wildcards);
+  g_hash_table_destroy (matcher->netgroups);
+  free_trie (matcher->ipv4);
+  free_trie (matcher->ipv6);
+  g_slist_free (matcher->anonymous);
+
+  g_slist_foreach (matcher->rules, (GFunc) g_free, NULL);
+  g_slist_free (matcher->rules);
+
+  g_free (matcher);
+}
+
+static void
+apply_rules (OobsNFSAclRule **best,
+             GSList          *rules)
+{
+  OobsNFSAclRule *rule, *current;
+
+  while (rules)
+    {
+      rule = rules->data;
+      current = best[rule->share];
+
+      if (!current ||
+	  rule->rank < current->rank ||
+	  (rule->rank == current->rank && rule->index < current->index))
+	best[rule->share] = rule;
+
+      rules = rules->next;
+    }
+}
+
+static void
+apply_trie_rules (OobsNFSAclRule     **best,
+                  OobsNFSAclTrieNode  *node,
+                  const guchar        *address,
+                  guint                n_bits)
+{
+  guint i = 0;
+
+  while (node)
+    {
+      apply_rules (best, node->rules);
+
+      if (i == n_bits)
+	break;
+
+      node = node->child[(address[i / 8] >> (7 - (i % 8))) & 1];
+      i++;
+    }
+}
+
+typedef struct {
+  OobsNFSAclRule **best;
+  const gchar *hostname;
+} NetgroupData;
+
+#ifdef HAVE_INNETGR
+static void
+apply_netgroup_rules (gpointer key,
+                      gpointer value,
+                      gpointer user_data)
+{
+  NetgroupData *data = user_data;
+
+  if (innetgr (key, data->hostname, NULL, NULL))
+    apply_rules (data->best, value);
+}
+#endif
+
+/**
+ * oobs_nfs_acl_matcher_get_shares:
+ * @matcher: An #OobsNFSAclMatcher.
+ * @address: IP address of the client, or %NULL.
+ * @hostname: host name of the client, or %NULL.
+ * @netgroups: %NULL-terminated array of netgroups the client is a member of,
+ *             or %NULL to query them through innetgr() for @hostname.
+ * @writable: whether only the shares that the client can write to should
+ *            be returned.
+ *
+ * Evaluates the compiled ACLs against a client. When a client matches
+ * several elements of the same ACL, the first one in this order takes
+ * precedence: host name or address, network, wildcard, netgroup and
+ * "*", then the order of the elements in the ACL, as NFS does.
+ *
+ * Return Value: A #GList of the #OobsShareNFS the client has access to.
+ *               The shares are owned by @matcher, the list must be freed
+ *               with g_list_free().
+ **/
+GList*
+oobs_nfs_acl_matcher_get_shares (OobsNFSAclMatcher  *matcher,
+                                 const gchar        *address,
+                                 const gchar        *hostname,
+                                 const gchar       **netgroups,
+                                 gboolean            writable)
+{
+  OobsNFSAclRule **best;
+  OobsNFSAclWildcard *wildcard;
+  GHashTableIter iter;
+  guchar addr[sizeof (struct in6_addr)];
+  gchar *name = NULL, *normalized;
+  GList *shares = NULL;
+  gint i;
+
+  g_return_val_if_fail (matcher != NULL, NULL);
+
+  best = g_new0 (OobsNFSAclRule *, matcher->shares->len);
+
+  if (hostname && *hostname)
+    {
+      name = g_ascii_strdown (hostname, -1);
+      apply_rules (best, g_hash_table_lookup (matcher->hosts, name));
+    }
+
+  if (address && *address)
+    {
+      normalized = normalize_address (address);
+
+      if (normalized)
+	{
+	  apply_rules (best, g_hash_table_lookup (matcher->hosts, normalized));
+	  g_free (normalized);
+	}
+
+      if (inet_pton (AF_INET, address, addr) == 1)
+	apply_trie_rules (best, matcher->ipv4, addr, 32);
+      else if (inet_pton (AF_INET6, address, addr) == 1)
+	apply_trie_rules (best, matcher->ipv6, addr, 128);
+    }
+
+  if (name)
+    {
+      g_hash_table_iter_init (&iter, matcher->wildcards);
+
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &wildcard))
+	{
+	  if (g_pattern_match_string (wildcard->pattern, name))
+	    apply_rules (best, wildcard->rules);
+	}
+    }
+
+  if (netgroups)
+    {
+      for (i = 0; netgroups[i]; i++)
+	apply_rules (best, g_hash_table_lookup (matcher->netgroups, netgroups[i]));
+    }
+#ifdef HAVE_INNETGR
+  else if (hostname && *hostname)
+    {
+      NetgroupData data = { best, hostname };
+
+      g_hash_table_foreach (matcher->netgroups, apply_netgroup_rules, &data);
+    }
+#endif
+
+  apply_rules (best, matcher->anonymous);
+
+  for (i = matcher->shares->len - 1; i >= 0; i--)
+    {
+      if (best[i] && (!writable || !best[i]->read_only))
+	shares = g_list_prepend (shares, g_ptr_array_index (matcher->shares, i));
+    }
+
+  g_free (best);
+  g_free (name);
+
+  return shares;
+}
@@ -37,6 +37,7 @@ G_BEGIN_DECLS
 
 typedef struct _OobsNFSConfig      OobsNFSConfig;
 typedef struct _OobsNFSConfigClass OobsNFSConfigClass;
+typedef struct _OobsNFSAclMatcher  OobsNFSAclMatcher;
 
 struct _OobsNFSConfig
 {
@@ -62,6 +63,15 @@ OobsObject* oobs_nfs_config_get          (void);
 
 OobsList*   oobs_nfs_config_get_shares   (OobsNFSConfig *config);
 
+OobsNFSAclMatcher* oobs_nfs_config_compile_acl_matcher (OobsNFSConfig *config);
+
+GList*      oobs_nfs_acl_matcher_get_shares (OobsNFSAclMatcher  *matcher,
+                                             const gchar        *address,
+                                             const gchar        *hostname,
+                                             const gchar       **netgroups,
+                                             gboolean            writable);
+void        oobs_nfs_acl_matcher_free       (OobsNFSAclMatcher  *matcher);
+
 G_END_DECLS
 
 #endif /* __OOBS_NFS_CONFIG_H */
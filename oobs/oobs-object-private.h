@@ -30,6 +30,24 @@ G_BEGIN_DECLS
 DBusMessage *_oobs_object_get_dbus_message (OobsObject *object);
 void         _oobs_object_set_dbus_message (OobsObject *object, DBusMessage *message);
 
+void         _oobs_object_class_set_reply_signature (OobsObjectClass *class,
+						     const gchar     *signature);
+
+/* Retrieves what commit() needs and isn't loaded yet. Asynchronous
+ * commits pass blocking as FALSE, nothing may be retrieved then. */
+typedef OobsResult (*_OobsObjectPrepareCommitFunc) (OobsObject *object,
+						    gboolean    blocking);
+
+void         _oobs_object_class_set_prepare_commit_func (OobsObjectClass              *class,
+							 _OobsObjectPrepareCommitFunc  func);
+
+#ifdef HAVE_GDBUS
+#include <gio/gio.h>
+
+GVariant    *_oobs_object_get_reply_variant (OobsObject *object);
+void         _oobs_object_class_set_variant_decoding (OobsObjectClass *class);
+#endif
+
 
 G_END_DECLS
 
@@ -18,8 +18,17 @@
  * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
  */
 
+#define _GNU_SOURCE /* memfd_create() and file seals */
+
+#include "config.h"
 #include <dbus/dbus.h>
 #include <glib-object.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "oobs-object.h"
 #include "oobs-object-private.h"
 #include "oobs-session.h"
@@ -36,8 +45,17 @@
 
 #define OOBS_OBJECT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_OBJECT, OobsObjectPrivate))
 
+/* Bulk transfers pass a file descriptor, supported since D-Bus 1.3.1 */
+#ifdef DBUS_TYPE_UNIX_FD
+#define HAVE_BULK_TRANSFER 1
+#endif
+
+/* Commit messages smaller than this are always sent inline */
+#define BULK_TRANSFER_THRESHOLD (64 * 1024)
+
 typedef struct _OobsObjectPrivate OobsObjectPrivate;
 typedef struct _OobsObjectAsyncCallbackData OobsObjectAsyncCallbackData;
+typedef struct _OobsObjectAuthenticateData OobsObjectAuthenticateData;
 
 struct _OobsObjectPrivate
 {
@@ -48,10 +66,16 @@ struct _OobsObjectPrivate
   gchar       *path;
   gchar       *method;
 
-  GList       *pending_calls;
+  /* asynchronous requests queued or in flight */
+  guint        n_requests;
+
+#ifdef HAVE_GDBUS
+  guint        changed_id;
+#endif
 
   guint        update_requests;
   guint        updated : 1;
+  guint        filter_added : 1;
 };
 
 struct _OobsObjectAsyncCallbackData
@@ -60,6 +84,20 @@ struct _OobsObjectAsyncCallbackData
   gboolean update;
   OobsObjectAsyncFunc func;
   gpointer data;
+
+  /* kept until the session lets it be sent */
+  DBusMessage *message;
+#ifdef HAVE_GDBUS
+  GDBusMessage *gdbus_message;
+#endif
+  OobsSessionRequest *request;
+};
+
+struct _OobsObjectAuthenticateData
+{
+  OobsObject *object;
+  OobsObjectAuthenticateFunc func;
+  gpointer data;
 };
 
 enum _OobsObjectCommitMethod
@@ -92,6 +130,14 @@ static DBusHandlerResult changed_signal_filter (DBusConnection *connection,
                                                 void           *user_data);
 
 static void connect_object_to_session (OobsObject *object);
+static void session_connected_cb       (OobsObject *object);
+
+#ifdef HAVE_GDBUS
+static GDBusMessage* to_gdbus_message (DBusMessage *message);
+static GDBusConnection* get_gdbus_connection (OobsObject *object);
+static void send_gdbus_message_async  (OobsSessionRequest *request,
+				       gpointer            data);
+#endif
 
 enum
 {
@@ -108,6 +154,13 @@ enum
 };
 
 static GQuark dbus_connection_quark;
+static GQuark reply_signature_quark;
+static GQuark prepare_commit_quark;
+
+#ifdef HAVE_GDBUS
+static GQuark gdbus_reply_quark;
+static GQuark variant_decoding_quark;
+#endif
 
 static guint object_signals [LAST_SIGNAL] = { 0 };
 
@@ -124,6 +177,12 @@ oobs_object_class_init (OobsObjectClass *class)
   object_class->finalize     = oobs_object_finalize;
 
   dbus_connection_quark = g_quark_from_static_string ("oobs-dbus-connection");
+  reply_signature_quark = g_quark_from_static_string ("oobs-reply-signature");
+  prepare_commit_quark = g_quark_from_static_string ("oobs-prepare-commit");
+#ifdef HAVE_GDBUS
+  gdbus_reply_quark = g_quark_from_static_string ("oobs-gdbus-reply");
+  variant_decoding_quark = g_quark_from_static_string ("oobs-variant-decoding");
+#endif
 
   g_object_class_install_property (object_class,
 				   PROP_REMOTE_OBJECT,
@@ -187,13 +246,22 @@ oobs_object_finalize (GObject *object)
   obj  = OOBS_OBJECT (object);
   priv = OOBS_OBJECT (object)->_priv;
 
-  /* Cancel all pending calls, they're going to be orphaned soon */
-  g_list_foreach (priv->pending_calls, (GFunc) dbus_pending_call_cancel, NULL);
-  g_list_foreach (priv->pending_calls, (GFunc) dbus_pending_call_unref, NULL);
-  g_list_free (priv->pending_calls);
-
-  connection = _oobs_session_get_connection_bus (priv->session);
-  dbus_connection_remove_filter (connection, changed_signal_filter, object);
+#ifdef HAVE_GDBUS
+  if (priv->changed_id)
+    g_dbus_connection_signal_unsubscribe (_oobs_session_get_gdbus_connection (priv->session),
+					  priv->changed_id);
+  else
+#endif
+  if (priv->filter_added)
+    {
+      connection = _oobs_session_get_connection_bus (priv->session);
+      dbus_connection_remove_filter (connection, changed_signal_filter, object);
+    }
+  else
+    {
+      /* finalized before the session got connected */
+      g_signal_handlers_disconnect_by_func (priv->session, session_connected_cb, object);
+    }
 
   /* changed_signal_filter() might have added an idle task on the object */
   g_idle_remove_by_data (object);
@@ -213,12 +281,19 @@ oobs_object_constructor (GType                  type,
 			 GObjectConstructParam *construct_params)
 {
   GObject *object;
+  OobsObjectPrivate *priv;
 
   object = (* G_OBJECT_CLASS (oobs_object_parent_class)->constructor) (type,
                                                                        n_construct_properties,
                                                                        construct_params);
+  priv = OOBS_OBJECT (object)->_priv;
 
-  connect_object_to_session (OOBS_OBJECT (object));
+  /* oobs_session_get_async() may still be setting up the connection */
+  if (_oobs_session_get_connecting (priv->session))
+    g_signal_connect_swapped (priv->session, "connected",
+			      G_CALLBACK (session_connected_cb), object);
+  else
+    connect_object_to_session (OOBS_OBJECT (object));
 
   return object;
 }
@@ -261,14 +336,48 @@ changed_signal_filter (DBusConnection *connection,
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+#ifdef HAVE_GDBUS
+static void
+changed_signal_cb (GDBusConnection *connection,
+		   const gchar     *sender_name,
+		   const gchar     *object_path,
+		   const gchar     *interface_name,
+		   const gchar     *signal_name,
+		   GVariant        *parameters,
+		   gpointer         user_data)
+{
+  /* same as changed_signal_filter() */
+  g_idle_remove_by_data (user_data);
+  g_idle_add (object_changed_idle, user_data);
+}
+#endif
+
 static void
 connect_object_to_session (OobsObject *object)
 {
   OobsObjectPrivate *priv;
   DBusConnection    *connection;
   gchar             *rule;
+#ifdef HAVE_GDBUS
+  GDBusConnection   *gdbus_connection;
+#endif
 
   priv = OOBS_OBJECT (object)->_priv;
+
+#ifdef HAVE_GDBUS
+  gdbus_connection = _oobs_session_get_gdbus_connection (priv->session);
+
+  if (gdbus_connection)
+    {
+      priv->changed_id = g_dbus_connection_signal_subscribe (gdbus_connection, NULL,
+							     priv->method, "changed",
+							     priv->path, NULL,
+							     G_DBUS_SIGNAL_FLAGS_NONE,
+							     changed_signal_cb, object, NULL);
+      return;
+    }
+#endif
+
   connection = _oobs_session_get_connection_bus (priv->session);
 
   if (!connection)
@@ -278,6 +387,7 @@ connect_object_to_session (OobsObject *object)
     }
 
   dbus_connection_add_filter (connection, changed_signal_filter, object, NULL);
+  priv->filter_added = TRUE;
 
   rule = g_strdup_printf ("type='signal',interface='%s',path='%s'",
 			  priv->method, priv->path);
@@ -292,6 +402,17 @@ connect_object_to_session (OobsObject *object)
   g_free (rule);
 }
 
+static void
+session_connected_cb (OobsObject *object)
+{
+  OobsObjectPrivate *priv;
+
+  priv = object->_priv;
+
+  g_signal_handlers_disconnect_by_func (priv->session, session_connected_cb, object);
+  connect_object_to_session (object);
+}
+
 static void
 oobs_object_set_property (GObject      *object,
 			  guint         prop_id,
@@ -330,10 +451,105 @@ oobs_object_get_property (GObject      *object,
     }
 }
 
+#ifdef HAVE_GDBUS
+static GDBusMessage*
+to_gdbus_message (DBusMessage *message)
+{
+  GDBusMessage *gdbus_message;
+  GError *error = NULL;
+  gchar *blob;
+  gint len;
+
+  /* any serial makes a valid header, GDBus assigns its own on send */
+  dbus_message_set_serial (message, 1);
+
+  if (!dbus_message_marshal (message, &blob, &len))
+    return NULL;
+
+  gdbus_message = g_dbus_message_new_from_blob ((guchar *) blob, len,
+						G_DBUS_CAPABILITY_FLAGS_NONE, &error);
+  dbus_free (blob);
+
+  if (!gdbus_message)
+    {
+      g_critical ("Could not convert message for GDBus: %s", error->message);
+      g_error_free (error);
+    }
+
+  return gdbus_message;
+}
+
+static DBusMessage*
+from_gdbus_message (GDBusMessage *gdbus_message)
+{
+  DBusMessage *message;
+  DBusError dbus_error;
+  GError *error = NULL;
+  guchar *blob;
+  gsize len;
+
+  blob = g_dbus_message_to_blob (gdbus_message, &len, G_DBUS_CAPABILITY_FLAGS_NONE, &error);
+
+  if (!blob)
+    {
+      g_critical ("Could not convert message from GDBus: %s", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  dbus_error_init (&dbus_error);
+  message = dbus_message_demarshal ((gchar *) blob, len, &dbus_error);
+  g_free (blob);
+
+  if (dbus_error_is_set (&dbus_error))
+    {
+      g_critical ("Could not convert message from GDBus: %s", dbus_error.message);
+      dbus_error_free (&dbus_error);
+    }
+
+  return message;
+}
+
+/*
+ * Returns the body of the reply being processed by the update()
+ * method if it was received through GDBus, or %NULL otherwise.
+ * Objects can decode it directly instead of going through
+ * _oobs_object_get_dbus_message(), which converts it.
+ */
+GVariant*
+_oobs_object_get_reply_variant (OobsObject *object)
+{
+  GDBusMessage *reply;
+
+  reply = g_object_get_qdata (G_OBJECT (object), gdbus_reply_quark);
+
+  return (reply) ? g_dbus_message_get_body (reply) : NULL;
+}
+#endif
+
 DBusMessage*
 _oobs_object_get_dbus_message (OobsObject *object)
 {
-  return (DBusMessage *) g_object_get_qdata (G_OBJECT (object), dbus_connection_quark);
+  DBusMessage *message;
+#ifdef HAVE_GDBUS
+  GDBusMessage *reply;
+#endif
+
+  message = g_object_get_qdata (G_OBJECT (object), dbus_connection_quark);
+
+#ifdef HAVE_GDBUS
+  /* replies received through GDBus are only converted on demand,
+   * update_object_from_message() frees the converted message */
+  reply = g_object_get_qdata (G_OBJECT (object), gdbus_reply_quark);
+
+  if (!message && reply)
+    {
+      message = from_gdbus_message (reply);
+      g_object_set_qdata (G_OBJECT (object), dbus_connection_quark, message);
+    }
+#endif
+
+  return message;
 }
 
 void
@@ -343,12 +559,103 @@ _oobs_object_set_dbus_message (OobsObject *object, DBusMessage *message)
 			   message, (GDestroyNotify) dbus_message_unref);
 }
 
+/*
+ * Sets the signature replies must have for the update() implementation
+ * of the class. Replies are then validated once before update() runs,
+ * which may rely on the utils_get_*() functions skipping type checks.
+ */
+void
+_oobs_object_class_set_reply_signature (OobsObjectClass *class,
+					const gchar     *signature)
+{
+  g_type_set_qdata (G_TYPE_FROM_CLASS (class), reply_signature_quark, (gpointer) signature);
+}
+
+static const gchar*
+get_reply_signature (OobsObject *object)
+{
+  const gchar *signature = NULL;
+  GType type;
+
+  for (type = G_OBJECT_TYPE (object);
+       !signature && type != OOBS_TYPE_OBJECT;
+       type = g_type_parent (type))
+    signature = g_type_get_qdata (type, reply_signature_quark);
+
+  return signature;
+}
+
+/*
+ * Sets the function retrieving what the commit() implementation of
+ * the class needs before the commit message is built, so commit()
+ * itself never has to run a request.
+ */
+void
+_oobs_object_class_set_prepare_commit_func (OobsObjectClass              *class,
+					    _OobsObjectPrepareCommitFunc  func)
+{
+  g_type_set_qdata (G_TYPE_FROM_CLASS (class), prepare_commit_quark, func);
+}
+
+static OobsResult
+prepare_commit (OobsObject *object,
+		gboolean    blocking)
+{
+  _OobsObjectPrepareCommitFunc func = NULL;
+  GType type;
+
+  for (type = G_OBJECT_TYPE (object);
+       !func && type != OOBS_TYPE_OBJECT;
+       type = g_type_parent (type))
+    func = (_OobsObjectPrepareCommitFunc) g_type_get_qdata (type, prepare_commit_quark);
+
+  if (!func)
+    return OOBS_RESULT_OK;
+
+  return (* func) (object, blocking);
+}
+
+static gboolean
+reply_has_signature (OobsObject  *object,
+		     DBusMessage *message,
+		     const gchar *signature)
+{
+#ifdef HAVE_GDBUS
+  GDBusMessage *reply;
+  GVariant *body;
+  gchar *type_string;
+  gboolean retval;
+
+  reply = g_object_get_qdata (G_OBJECT (object), gdbus_reply_quark);
+
+  if (!message && reply)
+    {
+      body = g_dbus_message_get_body (reply);
+
+      if (!body)
+	return FALSE;
+
+      /* the body is a tuple of all the arguments */
+      type_string = g_strdup_printf ("(%s)", signature);
+      retval = (strcmp (g_variant_get_type_string (body), type_string) == 0);
+      g_free (type_string);
+
+      return retval;
+    }
+#endif
+
+  return dbus_message_has_signature (message, signature);
+}
+
 static OobsResult
 update_object_from_message (OobsObject  *object,
 			    DBusMessage *message)
 {
   OobsObjectPrivate *priv;
   OobsObjectClass *class;
+  DBusMessage *converted;
+  const gchar *signature;
+  gboolean validated;
 
   class = OOBS_OBJECT_GET_CLASS (object);
 
@@ -359,22 +666,120 @@ update_object_from_message (OobsObject  *object,
     }
 
   priv = object->_priv;
-  priv->updated = TRUE;
 
   if (priv->update_requests == 0)
     g_critical ("update requests count already reached 0");
   else
     priv->update_requests--;
 
+  signature = get_reply_signature (object);
+
+  if (signature && !reply_has_signature (object, message, signature))
+    {
+      g_warning ("Discarding malformed reply from the backends, expected signature %s",
+		 signature);
+      return OOBS_RESULT_MALFORMED_DATA;
+    }
+
+  priv->updated = TRUE;
+
   g_object_set_qdata (G_OBJECT (object), dbus_connection_quark, message);
+
+  /* nested updates of other objects restore the previous state */
+  validated = utils_set_validated_reads (signature != NULL);
   class->update (object);
-  g_object_steal_qdata (G_OBJECT (object), dbus_connection_quark);
+  utils_set_validated_reads (validated);
+
+  converted = g_object_steal_qdata (G_OBJECT (object), dbus_connection_quark);
+
+  /* converted from a GDBus reply by _oobs_object_get_dbus_message() */
+  if (!message && converted)
+    dbus_message_unref (converted);
 
   g_signal_emit (object, object_signals [UPDATED], 0);
 
   return OOBS_RESULT_OK;
 }
 
+#ifdef HAVE_BULK_TRANSFER
+/*
+ * Backends may reply to getFd with a single file descriptor
+ * holding the marshalled reply, which is mapped and decoded
+ * here. Inline replies are returned untouched, %NULL is
+ * returned if the descriptor contents can't be decoded.
+ */
+static DBusMessage*
+get_bulk_reply (DBusMessage *reply)
+{
+  DBusMessage *message = NULL;
+  DBusError error;
+  struct stat st;
+  gpointer data;
+  int fd, seals;
+
+  if (!dbus_message_has_signature (reply, DBUS_TYPE_UNIX_FD_AS_STRING))
+    return reply;
+
+  dbus_error_init (&error);
+
+  if (!dbus_message_get_args (reply, &error, DBUS_TYPE_UNIX_FD, &fd, DBUS_TYPE_INVALID))
+    {
+      g_warning ("Could not get the bulk reply: %s", error.message);
+      dbus_error_free (&error);
+      dbus_message_unref (reply);
+      return NULL;
+    }
+
+  dbus_message_unref (reply);
+
+  /* the sender could otherwise shrink the file while it's
+   * mapped, making the reads below raise SIGBUS */
+  seals = fcntl (fd, F_GET_SEALS);
+
+  if (seals < 0 ||
+      (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE))
+    {
+      g_warning ("The bulk reply is not sealed, ignoring it");
+      close (fd);
+      return NULL;
+    }
+
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+  message = dbus_message_demarshal (data, st.st_size, &error);
+  munmap (data, st.st_size);
+
+  if (dbus_error_is_set (&error))
+    {
+      g_warning ("Could not decode the bulk reply: %s", error.message);
+      dbus_error_free (&error);
+    }
+
+  return message;
+}
+#endif
+
+static void
+forget_authorization (OobsObject *object)
+{
+  OobsObjectPrivate *priv;
+
+  priv = object->_priv;
+  _oobs_session_set_authorized (priv->session,
+				oobs_session_get_authentication_action (priv->session),
+				FALSE);
+}
+
 static DBusMessage*
 run_message (OobsObject  *object,
 	     DBusMessage *message,
@@ -386,19 +791,22 @@ run_message (OobsObject  *object,
 
   priv = object->_priv;
 
-  if (!oobs_session_get_connected (priv->session))
+  if (!_oobs_session_ensure_connected (priv->session))
     {
       g_warning ("Could not send message, OobsSession hasn't connected to the bus");
       return NULL;
     }
 
-  connection = _oobs_session_get_connection_bus (priv->session);
+  connection = _oobs_session_get_object_connection (priv->session);
   reply = dbus_connection_send_with_reply_and_block (connection, message, -1, &priv->dbus_error);
 
   if (dbus_error_is_set (&priv->dbus_error))
     {
       if (dbus_error_has_name (&priv->dbus_error, DBUS_ERROR_ACCESS_DENIED))
-	*result = OOBS_RESULT_ACCESS_DENIED;
+	{
+	  forget_authorization (object);
+	  *result = OOBS_RESULT_ACCESS_DENIED;
+	}
       else
 	g_warning ("There was an unknown error communicating with the backends: %s", priv->dbus_error.message);
 
@@ -406,10 +814,52 @@ run_message (OobsObject  *object,
       return NULL;
     }
 
+#ifdef HAVE_BULK_TRANSFER
+  reply = get_bulk_reply (reply);
+
+  if (!reply)
+    {
+      *result = OOBS_RESULT_MALFORMED_DATA;
+      return NULL;
+    }
+#endif
+
   *result = OOBS_RESULT_OK;
   return reply;
 }
 
+/*
+ * Common end of asynchronous requests, lets the session send the
+ * next queued request and notifies the caller.
+ */
+static void
+finish_async_request (OobsObjectAsyncCallbackData *async_data,
+		      OobsResult                   result)
+{
+  OobsObjectPrivate *priv;
+
+  priv = async_data->object->_priv;
+  priv->n_requests--;
+
+  if (result == OOBS_RESULT_ACCESS_DENIED)
+    forget_authorization (async_data->object);
+
+  _oobs_session_request_done (priv->session, async_data->request);
+
+  if (async_data->func)
+    (* async_data->func) (OOBS_OBJECT (async_data->object), result, async_data->data);
+
+  if (async_data->message)
+    dbus_message_unref (async_data->message);
+#ifdef HAVE_GDBUS
+  if (async_data->gdbus_message)
+    g_object_unref (async_data->gdbus_message);
+#endif
+
+  g_object_unref (async_data->object);
+  g_free (async_data);
+}
+
 static void
 async_message_cb (DBusPendingCall *pending_call, gpointer data)
 {
@@ -417,6 +867,7 @@ async_message_cb (DBusPendingCall *pending_call, gpointer data)
   OobsObjectAsyncCallbackData *async_data;
   OobsResult result = OOBS_RESULT_MALFORMED_DATA;
   DBusMessage *reply;
+  DBusMessageIter iter;
   DBusError error;
 
   dbus_error_init (&error);
@@ -436,62 +887,452 @@ async_message_cb (DBusPendingCall *pending_call, gpointer data)
 
       dbus_error_free (&error);
     }
+#ifdef HAVE_BULK_TRANSFER
+  else if (!(reply = get_bulk_reply (reply)))
+    result = OOBS_RESULT_MALFORMED_DATA;
+#endif
   else
     {
       if (async_data->update)
 	result = update_object_from_message (OOBS_OBJECT (async_data->object), reply);
       else
 	{
+	  /* Same as do_commit(), objects can update themselves
+	   * when the backend provides it */
+	  dbus_message_iter_init (reply, &iter);
+
+	  if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_STRUCT)
+	    {
+	      priv = async_data->object->_priv;
+	      priv->update_requests++;
+	      update_object_from_message (OOBS_OBJECT (async_data->object), reply);
+	    }
+
 	  g_signal_emit (async_data->object, object_signals [COMMITTED], 0);
 	  result = OOBS_RESULT_OK;
 	}
     }
 
-  priv = async_data->object->_priv;
-  priv->pending_calls = g_list_remove (priv->pending_calls, pending_call);
+  finish_async_request (async_data, result);
+
+  if (reply)
+    dbus_message_unref (reply);
+
+  dbus_pending_call_unref (pending_call);
+}
+
+/* Called by the session once the request can be sent */
+static void
+send_message_async (OobsSessionRequest *request,
+		    gpointer            data)
+{
+  OobsObjectPrivate *priv;
+  OobsObjectAsyncCallbackData *async_data;
+  DBusConnection *connection;
+  DBusPendingCall *call = NULL;
+
+  async_data = (OobsObjectAsyncCallbackData*) data;
+  async_data->request = request;
+  priv = async_data->object->_priv;
+
+#ifdef HAVE_GDBUS
+  /* queued while the session was connecting, before it
+   * was known whether GDBus would be used */
+  if (get_gdbus_connection (async_data->object))
+    {
+      async_data->gdbus_message = to_gdbus_message (async_data->message);
+
+      if (async_data->gdbus_message)
+	send_gdbus_message_async (request, data);
+      else
+	finish_async_request (async_data, OOBS_RESULT_ERROR);
+
+      return;
+    }
+#endif
+
+  connection = _oobs_session_get_object_connection (priv->session);
+
+  if (!connection)
+    {
+      g_warning ("Could not send message, OobsSession hasn't connected to the bus");
+      finish_async_request (async_data, OOBS_RESULT_ERROR);
+      return;
+    }
+
+  /* Ideally, backends should reply quickly, possibly saying operation is still pending.
+   * Since they currently block without replying, set the timeout to something long. */
+  if (!dbus_connection_send_with_reply (connection, async_data->message, &call, INT_MAX) || !call)
+    {
+      g_warning ("Could not send message to the backends");
+      finish_async_request (async_data, OOBS_RESULT_ERROR);
+      return;
+    }
+
+  _oobs_session_request_set_pending_call (request, call);
+  dbus_pending_call_set_notify (call, async_message_cb, async_data, NULL);
+}
+
+static void
+run_message_async (OobsObject          *object,
+		   DBusMessage         *message,
+		   gboolean             update,
+		   OobsRequestPriority  priority,
+		   OobsObjectAsyncFunc  func,
+		   gpointer             data)
+{
+  OobsObjectPrivate *priv;
+  OobsObjectAsyncCallbackData *async_data;
+
+  priv = object->_priv;
+
+  /* requests are queued while the session is connecting */
+  if (!_oobs_session_get_connecting (priv->session) &&
+      !oobs_session_get_connected (priv->session))
+    {
+      g_warning ("could not send message, OobsSession hasn't connected to the bus");
+      return;
+    }
+
+  async_data = g_new0 (OobsObjectAsyncCallbackData, 1);
+  async_data->object = g_object_ref (object);
+  async_data->update = update;
+  async_data->func = func;
+  async_data->data = data;
+  async_data->message = dbus_message_ref (message);
+
+  /* the session may hold it back if too many requests are in flight */
+  priv->n_requests++;
+  _oobs_session_queue_request (priv->session, priority, send_message_async, async_data);
+}
+
+#ifdef HAVE_GDBUS
+static GDBusConnection*
+get_gdbus_connection (OobsObject *object)
+{
+  OobsObjectPrivate *priv;
+
+  priv = object->_priv;
+
+  return (priv->session) ? _oobs_session_get_gdbus_object_connection (priv->session) : NULL;
+}
+
+static OobsResult
+get_gdbus_reply_result (GDBusMessage *reply)
+{
+  const gchar *error_name;
+
+  if (g_dbus_message_get_message_type (reply) != G_DBUS_MESSAGE_TYPE_ERROR)
+    return OOBS_RESULT_OK;
+
+  error_name = g_dbus_message_get_error_name (reply);
+
+  if (error_name && strcmp (error_name, DBUS_ERROR_ACCESS_DENIED) == 0)
+    return OOBS_RESULT_ACCESS_DENIED;
+
+  g_warning ("There was an unknown error communicating with the backends: %s", error_name);
+  return OOBS_RESULT_ERROR;
+}
+
+/*
+ * Lets the update() implementation of the class decode GDBus replies
+ * with _oobs_object_get_reply_variant(), they are otherwise converted
+ * to a DBusMessage before update() runs.
+ */
+void
+_oobs_object_class_set_variant_decoding (OobsObjectClass *class)
+{
+  g_type_set_qdata (G_TYPE_FROM_CLASS (class), variant_decoding_quark, GINT_TO_POINTER (TRUE));
+}
+
+static gboolean
+has_variant_decoding (OobsObject *object)
+{
+  GType type;
+
+  for (type = G_OBJECT_TYPE (object);
+       type != OOBS_TYPE_OBJECT;
+       type = g_type_parent (type))
+    if (g_type_get_qdata (type, variant_decoding_quark))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* GDBus counterpart of update_object_from_message() */
+static OobsResult
+update_object_from_gdbus_message (OobsObject   *object,
+				  GDBusMessage *reply)
+{
+  OobsObjectPrivate *priv;
+  DBusMessage *message;
+  OobsResult result;
+
+  if (has_variant_decoding (object))
+    {
+      /* only converted if update() asks for it */
+      g_object_set_qdata (G_OBJECT (object), gdbus_reply_quark, reply);
+      result = update_object_from_message (object, NULL);
+      g_object_steal_qdata (G_OBJECT (object), gdbus_reply_quark);
+
+      return result;
+    }
+
+  message = from_gdbus_message (reply);
+
+  if (!message)
+    {
+      /* same bookkeeping as update_object_from_message() */
+      priv = object->_priv;
+
+      if (priv->update_requests > 0)
+	priv->update_requests--;
+
+      return OOBS_RESULT_MALFORMED_DATA;
+    }
+
+  result = update_object_from_message (object, message);
+  dbus_message_unref (message);
+
+  return result;
+}
+
+/* Same check as in do_commit(), whether the
+ * reply to a commit carries the updated object */
+static gboolean
+gdbus_reply_has_update (GDBusMessage *reply)
+{
+  GVariant *body, *child;
+  gboolean has_update = FALSE;
+
+  body = g_dbus_message_get_body (reply);
+
+  if (body && g_variant_n_children (body) > 0)
+    {
+      child = g_variant_get_child_value (body, 0);
+      has_update = g_variant_is_of_type (child, G_VARIANT_TYPE_TUPLE);
+      g_variant_unref (child);
+    }
+
+  return has_update;
+}
+
+static GDBusMessage*
+run_gdbus_message (OobsObject  *object,
+		   DBusMessage *message,
+		   OobsResult  *result)
+{
+  GDBusMessage *gdbus_message, *reply;
+  GError *error = NULL;
+
+  gdbus_message = to_gdbus_message (message);
+
+  if (!gdbus_message)
+    {
+      *result = OOBS_RESULT_MALFORMED_DATA;
+      return NULL;
+    }
+
+  reply = g_dbus_connection_send_message_with_reply_sync (get_gdbus_connection (object),
+							  gdbus_message,
+							  G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+							  -1, NULL, NULL, &error);
+  g_object_unref (gdbus_message);
+
+  if (!reply)
+    {
+      g_warning ("There was an unknown error communicating with the backends: %s", error->message);
+      g_error_free (error);
+      *result = OOBS_RESULT_ERROR;
+      return NULL;
+    }
+
+  *result = get_gdbus_reply_result (reply);
+
+  if (*result == OOBS_RESULT_ACCESS_DENIED)
+    forget_authorization (object);
+
+  if (*result != OOBS_RESULT_OK)
+    {
+      g_object_unref (reply);
+      return NULL;
+    }
+
+  return reply;
+}
+
+static void
+gdbus_async_message_cb (GObject      *source,
+			GAsyncResult *res,
+			gpointer      data)
+{
+  OobsObjectPrivate *priv;
+  OobsObjectAsyncCallbackData *async_data;
+  OobsResult result;
+  GDBusMessage *reply;
+  GError *error = NULL;
+
+  async_data = (OobsObjectAsyncCallbackData*) data;
+  reply = g_dbus_connection_send_message_with_reply_finish (G_DBUS_CONNECTION (source),
+							    res, &error);
+  if (!reply)
+    {
+      g_warning ("There was an unknown error communicating asynchronously with the backends: %s",
+		 error->message);
+      g_error_free (error);
+      result = OOBS_RESULT_ERROR;
+    }
+  else
+    {
+      result = get_gdbus_reply_result (reply);
+
+      if (result != OOBS_RESULT_OK)
+	;
+      else if (async_data->update)
+	result = update_object_from_gdbus_message (OOBS_OBJECT (async_data->object), reply);
+      else
+	{
+	  /* Same as async_message_cb() */
+	  if (gdbus_reply_has_update (reply))
+	    {
+	      priv = async_data->object->_priv;
+	      priv->update_requests++;
+	      update_object_from_gdbus_message (OOBS_OBJECT (async_data->object), reply);
+	    }
+
+	  g_signal_emit (async_data->object, object_signals [COMMITTED], 0);
+	}
+
+      g_object_unref (reply);
+    }
+
+  finish_async_request (async_data, result);
+}
+
+/* Sends the request once send_message_async() converted it */
+static void
+send_gdbus_message_async (OobsSessionRequest *request,
+			  gpointer            data)
+{
+  OobsObjectAsyncCallbackData *async_data;
 
-  if (async_data->func)
-    (* async_data->func) (OOBS_OBJECT (async_data->object), result, async_data->data);
+  async_data = (OobsObjectAsyncCallbackData*) data;
+  async_data->request = request;
 
-  dbus_message_unref (reply);
-  g_object_unref (async_data->object);
-  dbus_pending_call_unref (pending_call);
+  /* See send_message_async() about the timeout */
+  g_dbus_connection_send_message_with_reply (get_gdbus_connection (async_data->object),
+					     async_data->gdbus_message,
+					     G_DBUS_SEND_MESSAGE_FLAGS_NONE, G_MAXINT,
+					     NULL, NULL, gdbus_async_message_cb, async_data);
 }
+#endif
 
-static void
-run_message_async (OobsObject          *object,
-		   DBusMessage         *message,
-		   gboolean             update,
-		   OobsObjectAsyncFunc  func,
-		   gpointer             data)
+#ifdef HAVE_BULK_TRANSFER
+static gboolean
+uses_bulk_transfer (OobsObject *object)
 {
   OobsObjectPrivate *priv;
-  DBusPendingCall *call;
-  OobsObjectAsyncCallbackData *async_data;
-  DBusConnection *connection;
 
   priv = object->_priv;
 
-  if (!oobs_session_get_connected (priv->session))
+  if (!_oobs_session_get_bulk_transfer (priv->session))
+    return FALSE;
+
+#ifdef HAVE_GDBUS
+  /* file descriptors don't survive the conversion to GDBus messages */
+  if (get_gdbus_connection (object))
+    return FALSE;
+#endif
+
+  return dbus_connection_can_send_type (_oobs_session_get_object_connection (priv->session),
+					DBUS_TYPE_UNIX_FD);
+}
+
+/*
+ * Replaces a large commit message with a call to the "Fd" variant of
+ * the method, passing a sealed memfd that holds the marshalled message.
+ * The original message is returned if it's small or anything fails.
+ */
+static DBusMessage*
+get_bulk_message (DBusMessage *message)
+{
+#ifdef HAVE_MEMFD_CREATE
+  DBusMessage *bulk_message, *copy;
+  gchar *blob, *member;
+  gint len, written, fd;
+  gssize res;
+  dbus_bool_t marshalled;
+
+  /* marshalling needs a serial, set it on a copy since libdbus
+   * keeps an existing one when the message is sent inline */
+  copy = dbus_message_copy (message);
+
+  if (!copy)
+    return message;
+
+  dbus_message_set_serial (copy, 1);
+  marshalled = dbus_message_marshal (copy, &blob, &len);
+  dbus_message_unref (copy);
+
+  if (!marshalled)
+    return message;
+
+  if (len < BULK_TRANSFER_THRESHOLD)
     {
-      g_warning ("could not send message, OobsSession hasn't connected to the bus");
-      return;
+      dbus_free (blob);
+      return message;
     }
 
-  connection = _oobs_session_get_connection_bus (priv->session);
-  /* Ideally, backends should reply quickly, possibly saying operation is still pending.
-   * Since they currently block without replying, set the timeout to something long. */
-  dbus_connection_send_with_reply (connection, message, &call, INT_MAX);
+  fd = memfd_create ("oobs-bulk", MFD_CLOEXEC | MFD_ALLOW_SEALING);
 
-  async_data = g_new0 (OobsObjectAsyncCallbackData, 1);
-  async_data->object = g_object_ref (object);
-  async_data->update = update;
-  async_data->func = func;
-  async_data->data = data;
+  if (fd < 0)
+    {
+      dbus_free (blob);
+      return message;
+    }
+
+  for (written = 0; written < len; written += res)
+    {
+      res = write (fd, blob + written, len - written);
+
+      if (res < 0 && errno == EINTR)
+	{
+	  res = 0;
+	  continue;
+	}
+
+      if (res <= 0)
+	break;
+    }
+
+  dbus_free (blob);
+
+  /* backends may map the data, so it must not change underneath */
+  if (written < len ||
+      fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+      close (fd);
+      return message;
+    }
+
+  member = g_strconcat (dbus_message_get_member (message), "Fd", NULL);
+  bulk_message = dbus_message_new_method_call (dbus_message_get_destination (message),
+					       dbus_message_get_path (message),
+					       dbus_message_get_interface (message),
+					       member);
+  g_free (member);
 
-  dbus_pending_call_set_notify (call, async_message_cb, async_data, g_free);
-  priv->pending_calls = g_list_prepend (priv->pending_calls, call);
+  /* D-Bus duplicates the descriptor */
+  dbus_message_append_args (bulk_message, DBUS_TYPE_UNIX_FD, &fd, DBUS_TYPE_INVALID);
+  close (fd);
+
+  dbus_message_unref (message);
+  return bulk_message;
+#else
+  return message;
+#endif
 }
+#endif
 
 static DBusMessage*
 get_commit_message (_OobsObjectCommitMethod method, OobsObject *object)
@@ -547,6 +1388,10 @@ get_commit_message (_OobsObjectCommitMethod method, OobsObject *object)
       g_critical ("Not committing due to inconsistencies in the "
 		  "configuration, this reflects a bug in the application\n");
     }
+#ifdef HAVE_BULK_TRANSFER
+  else if (uses_bulk_transfer (object))
+    message = get_bulk_message (message);
+#endif
 
   return message;
 }
@@ -575,10 +1420,16 @@ get_update_message (OobsObject *object)
     {
       _oobs_object_set_dbus_message (object, message);
       class->get_update_message (object);
-      return g_object_steal_qdata (G_OBJECT (object), dbus_connection_quark);
+      message = g_object_steal_qdata (G_OBJECT (object), dbus_connection_quark);
     }
-  else
-    return message;
+
+#ifdef HAVE_BULK_TRANSFER
+  /* backends are then free to reply through a file descriptor */
+  if (message && uses_bulk_transfer (object))
+    dbus_message_set_member (message, "getFd");
+#endif
+
+  return message;
 }
 
 /*
@@ -595,11 +1446,44 @@ do_commit (_OobsObjectCommitMethod method, OobsObject *object)
 
   g_return_val_if_fail (OOBS_IS_OBJECT (object), OOBS_RESULT_MALFORMED_DATA);
 
+  result = prepare_commit (object, TRUE);
+
+  if (result != OOBS_RESULT_OK)
+    return result;
+
   message = get_commit_message (method, object);
 
   if (!message)
     return OOBS_RESULT_MALFORMED_DATA;
 
+#ifdef HAVE_GDBUS
+  if (get_gdbus_connection (object))
+    {
+      GDBusMessage *gdbus_reply;
+
+      gdbus_reply = run_gdbus_message (object, message, &result);
+      dbus_message_unref (message);
+
+      if (gdbus_reply)
+	{
+	  if (gdbus_reply_has_update (gdbus_reply))
+	    {
+	      priv = object->_priv;
+
+	      priv->update_requests++;
+	      result = update_object_from_gdbus_message (object, gdbus_reply);
+	    }
+
+	  g_object_unref (gdbus_reply);
+	}
+
+      if (result == OOBS_RESULT_OK)
+	g_signal_emit (object, object_signals [COMMITTED], 0);
+
+      return result;
+    }
+#endif
+
   reply = run_message (object, message, &result);
   dbus_message_unref (message);
 
@@ -617,7 +1501,9 @@ do_commit (_OobsObjectCommitMethod method, OobsObject *object)
 	}
     }
 
-  g_signal_emit (object, object_signals [COMMITTED], 0);
+  /* same as the asynchronous commits */
+  if (result == OOBS_RESULT_OK)
+    g_signal_emit (object, object_signals [COMMITTED], 0);
 
   return result;
 }
@@ -629,19 +1515,28 @@ do_commit (_OobsObjectCommitMethod method, OobsObject *object)
 static OobsResult
 do_commit_async (_OobsObjectCommitMethod method,
                  OobsObject             *object,
+                 OobsRequestPriority     priority,
                  OobsObjectAsyncFunc     func,
                  gpointer                data)
 {
   DBusMessage *message;
 
   g_return_val_if_fail (OOBS_IS_OBJECT (object), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (priority == OOBS_REQUEST_PRIORITY_INTERACTIVE ||
+			priority == OOBS_REQUEST_PRIORITY_BACKGROUND, OOBS_RESULT_MALFORMED_DATA);
+
+  /* retrieving missing data would block */
+  if (prepare_commit (object, FALSE) != OOBS_RESULT_OK)
+    return OOBS_RESULT_MALFORMED_DATA;
 
   message = get_commit_message (method, object);
 
   if (!message)
     return OOBS_RESULT_MALFORMED_DATA;
 
-  run_message_async (object, message, FALSE, func, data);
+  /* converted for GDBus once sent, see send_message_async() */
+  run_message_async (object, message, FALSE, priority, func, data);
+
   dbus_message_unref (message);
 
   return OOBS_RESULT_OK;
@@ -671,6 +1566,10 @@ oobs_object_commit (OobsObject *object)
  * Commits to the system all the changes done to the configuration held by an #OobsObject.
  * This change will be asynchronous, being run the function @func when the change has been done.
  *
+ * Objects with fields left out by their last update, see oobs_users_config_set_fields()
+ * and oobs_groups_config_set_fields(), can't be committed asynchronously, since retrieving
+ * those fields would block. OOBS_RESULT_MALFORMED is returned then, and @func isn't called.
+ *
  * Return value: an #OobsResult enum with the error code. Due to the asynchronous nature
  * of the function, only OOBS_RESULT_MALFORMED and OOBS_RESULT_OK can be returned.
  **/
@@ -679,7 +1578,30 @@ oobs_object_commit_async (OobsObject          *object,
 			  OobsObjectAsyncFunc  func,
 			  gpointer             data)
 {
-  return do_commit_async (METHOD_COMMIT, object, func, data);
+  return do_commit_async (METHOD_COMMIT, object, OOBS_REQUEST_PRIORITY_INTERACTIVE, func, data);
+}
+
+/**
+ * oobs_object_commit_async_full:
+ * @object: An #OobsObject.
+ * @priority: An #OobsRequestPriority.
+ * @func: An #OobsObjectAsyncFunc that will be called when the asynchronous operation has ended.
+ * @data: Additional data to pass to @func.
+ *
+ * Same as oobs_object_commit_async(), sending the request with the given
+ * @priority when the session limits the requests in flight, see
+ * oobs_session_set_max_requests().
+ *
+ * Return value: an #OobsResult enum with the error code. Due to the asynchronous nature
+ * of the function, only OOBS_RESULT_MALFORMED and OOBS_RESULT_OK can be returned.
+ **/
+OobsResult
+oobs_object_commit_async_full (OobsObject          *object,
+			       OobsRequestPriority  priority,
+			       OobsObjectAsyncFunc  func,
+			       gpointer             data)
+{
+  return do_commit_async (METHOD_COMMIT, object, priority, func, data);
 }
 
 /**
@@ -715,7 +1637,7 @@ oobs_object_add_async (OobsObject          *object,
                        OobsObjectAsyncFunc  func,
                        gpointer             data)
 {
-  return do_commit_async (METHOD_ADD, object, func, data);
+  return do_commit_async (METHOD_ADD, object, OOBS_REQUEST_PRIORITY_INTERACTIVE, func, data);
 }
 
 /**
@@ -751,7 +1673,7 @@ oobs_object_delete_async (OobsObject          *object,
                           OobsObjectAsyncFunc  func,
                           gpointer             data)
 {
-  return do_commit_async (METHOD_DELETE, object, func, data);
+  return do_commit_async (METHOD_DELETE, object, OOBS_REQUEST_PRIORITY_INTERACTIVE, func, data);
 }
 
 /**
@@ -780,6 +1702,25 @@ oobs_object_update (OobsObject *object)
     return OOBS_RESULT_MALFORMED_DATA;
 
   priv->update_requests++;
+
+#ifdef HAVE_GDBUS
+  if (get_gdbus_connection (object))
+    {
+      GDBusMessage *gdbus_reply;
+
+      gdbus_reply = run_gdbus_message (object, message, &result);
+
+      if (gdbus_reply)
+	{
+	  result = update_object_from_gdbus_message (object, gdbus_reply);
+	  g_object_unref (gdbus_reply);
+	}
+
+      dbus_message_unref (message);
+      return result;
+    }
+#endif
+
   reply = run_message (object, message, &result);
 
   if (reply)
@@ -811,10 +1752,38 @@ OobsResult
 oobs_object_update_async (OobsObject          *object,
 			  OobsObjectAsyncFunc  func,
 			  gpointer             data)
+{
+  return oobs_object_update_async_full (object, OOBS_REQUEST_PRIORITY_INTERACTIVE, func, data);
+}
+
+/**
+ * oobs_object_update_async_full:
+ * @object: An #OobsObject
+ * @priority: An #OobsRequestPriority
+ * @func: An #OobsObjectAsyncFunc that will be called when the asynchronous operation has ended.
+ * @data: Aditional data to pass to @func.
+ *
+ * Same as oobs_object_update_async(), sending the request with the given
+ * @priority when the session limits the requests in flight, see
+ * oobs_session_set_max_requests(). Objects refreshed in bulk should use
+ * #OOBS_REQUEST_PRIORITY_BACKGROUND, so they don't delay interactive requests.
+ *
+ * Return value: an #OobsResult enum with the error code. Due to the asynchronous nature
+ * of the function, only OOBS_RESULT_MALFORMED and OOBS_RESULT_OK can be returned.
+ **/
+OobsResult
+oobs_object_update_async_full (OobsObject          *object,
+			       OobsRequestPriority  priority,
+			       OobsObjectAsyncFunc  func,
+			       gpointer             data)
 {
   OobsObjectPrivate *priv;
   DBusMessage *message;
 
+  g_return_val_if_fail (OOBS_IS_OBJECT (object), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (priority == OOBS_REQUEST_PRIORITY_INTERACTIVE ||
+			priority == OOBS_REQUEST_PRIORITY_BACKGROUND, OOBS_RESULT_MALFORMED_DATA);
+
   priv = object->_priv;
   message = get_update_message (object);
 
@@ -822,7 +1791,10 @@ oobs_object_update_async (OobsObject          *object,
     return OOBS_RESULT_MALFORMED_DATA;
 
   priv->update_requests++;
-  run_message_async (object, message, TRUE, func, data);
+
+  /* converted for GDBus once sent, see send_message_async() */
+  run_message_async (object, message, TRUE, priority, func, data);
+
   dbus_message_unref (message);
 
   return OOBS_RESULT_OK;
@@ -833,6 +1805,12 @@ oobs_object_update_async (OobsObject          *object,
  * @object: An #OobsObject
  * 
  * Blocks until all pending asynchronous requests to this object have been processed.
+ *
+ * Replies sent through libdbus are waited for one by one, without
+ * dispatching anything else. With GDBus, or while the session is still
+ * being set up by oobs_session_get_async(), the default #GMainContext
+ * is iterated instead, so other sources attached to it may be
+ * dispatched before this returns, see oobs_session_wait().
  **/
 void
 oobs_object_process_requests (OobsObject *object)
@@ -841,7 +1819,10 @@ oobs_object_process_requests (OobsObject *object)
 
   g_return_if_fail (OOBS_IS_OBJECT (object));
   priv = object->_priv;
-  g_list_foreach (priv->pending_calls, (GFunc) dbus_pending_call_block, NULL);
+
+  /* requests may be queued behind others in the session */
+  while (priv->n_requests > 0)
+    _oobs_session_wait_request (priv->session);
 }
 
 /**
@@ -870,7 +1851,9 @@ oobs_object_has_updated (OobsObject *object)
  *
  * Ensures that the given object has been updated. If not
  * it either blocks until any update request sent is
- * dispatched or updates synchronously.
+ * dispatched or updates synchronously. The former may
+ * dispatch other sources from the default #GMainContext,
+ * see oobs_object_process_requests().
  **/
 void
 oobs_object_ensure_update (OobsObject *object)
@@ -895,6 +1878,155 @@ oobs_object_ensure_update (OobsObject *object)
     oobs_object_update (object);
 }
 
+static DBusMessage*
+create_authenticate_message (OobsObject *object)
+{
+  OobsObjectPrivate *priv;
+
+  priv = object->_priv;
+
+  return dbus_message_new_method_call (OOBS_DBUS_DESTINATION, priv->path,
+				       "org.freedesktop.SystemToolsBackends.Authentication",
+				       "authenticate");
+}
+
+/* Common to synchronous and asynchronous authentications, updates
+ * the session authorization cache with the backends answer */
+static gboolean
+get_authenticate_reply (OobsObject   *object,
+			DBusMessage  *reply,
+			DBusError    *dbus_error,
+			GError      **error)
+{
+  OobsObjectPrivate *priv;
+  DBusMessageIter iter;
+  gboolean result;
+
+  priv = object->_priv;
+
+  if (dbus_error_is_set (dbus_error))
+    {
+      if (dbus_error_has_name (dbus_error,
+                               "org.freedesktop.SystemToolsBackends.AuthenticationCancelled"))
+	g_set_error_literal (error, OOBS_ERROR,
+	                     OOBS_ERROR_AUTHENTICATION_CANCELLED,
+	                     dbus_error->message);
+      else
+	g_set_error_literal (error, OOBS_ERROR,
+	                     OOBS_ERROR_AUTHENTICATION_FAILED,
+	                     dbus_error->message);
+
+      dbus_error_free (dbus_error);
+      forget_authorization (object);
+      return FALSE;
+    }
+
+  dbus_message_iter_init (reply, &iter);
+  result = utils_get_boolean (&iter);
+
+  _oobs_session_set_authorized (priv->session,
+				oobs_session_get_authentication_action (priv->session),
+				result);
+  return result;
+}
+
+static void
+free_authenticate_data (OobsObjectAuthenticateData *auth_data)
+{
+  g_object_unref (auth_data->object);
+  g_free (auth_data);
+}
+
+static gboolean
+authenticate_cached_idle (gpointer data)
+{
+  OobsObjectAuthenticateData *auth_data;
+
+  auth_data = (OobsObjectAuthenticateData*) data;
+
+  if (auth_data->func)
+    (* auth_data->func) (auth_data->object, TRUE, NULL, auth_data->data);
+
+  free_authenticate_data (auth_data);
+  return FALSE;
+}
+
+/* Runs the callback with the result in dbus_error or reply,
+ * and frees auth_data */
+static void
+finish_authenticate (OobsObjectAuthenticateData *auth_data,
+		     DBusMessage                *reply,
+		     DBusError                  *dbus_error)
+{
+  GError *error = NULL;
+  gboolean result;
+
+  if (reply)
+    dbus_set_error_from_message (dbus_error, reply);
+
+  result = get_authenticate_reply (auth_data->object, reply, dbus_error, &error);
+
+  if (auth_data->func)
+    (* auth_data->func) (auth_data->object, result, error, auth_data->data);
+
+  if (error)
+    g_error_free (error);
+
+  free_authenticate_data (auth_data);
+}
+
+static void
+authenticate_async_cb (DBusPendingCall *pending_call,
+		       gpointer         data)
+{
+  DBusMessage *reply;
+  DBusError dbus_error;
+
+  reply = dbus_pending_call_steal_reply (pending_call);
+  dbus_error_init (&dbus_error);
+
+  finish_authenticate ((OobsObjectAuthenticateData*) data, reply, &dbus_error);
+
+  dbus_message_unref (reply);
+  dbus_pending_call_unref (pending_call);
+}
+
+#ifdef HAVE_GDBUS
+static void
+gdbus_authenticate_async_cb (GObject      *source,
+			     GAsyncResult *res,
+			     gpointer      data)
+{
+  GDBusMessage *gdbus_reply;
+  DBusMessage *reply = NULL;
+  DBusError dbus_error;
+  GError *error = NULL;
+
+  dbus_error_init (&dbus_error);
+  gdbus_reply = g_dbus_connection_send_message_with_reply_finish (G_DBUS_CONNECTION (source),
+								  res, &error);
+  if (gdbus_reply)
+    {
+      reply = from_gdbus_message (gdbus_reply);
+      g_object_unref (gdbus_reply);
+
+      if (!reply)
+	dbus_set_error_const (&dbus_error, DBUS_ERROR_FAILED,
+			      "Could not convert the reply from the backends");
+    }
+  else
+    {
+      dbus_set_error (&dbus_error, DBUS_ERROR_FAILED, "%s", error->message);
+      g_error_free (error);
+    }
+
+  finish_authenticate ((OobsObjectAuthenticateData*) data, reply, &dbus_error);
+
+  if (reply)
+    dbus_message_unref (reply);
+}
+#endif
+
 /**
  * oobs_object_authenticate:
  * @object: An #OobsObject.
@@ -902,7 +2034,8 @@ oobs_object_ensure_update (OobsObject *object)
  *
  * Performs a PolicyKit authentication via the backends for the action
  * required by the given object. User interaction will occur synchronously
- * if needed.
+ * if needed. Successful authentications are remembered for a while, see
+ * oobs_session_set_authorization_timeout().
  *
  * You may want to check the returned error for %OOBS_ERROR_AUTHENTICATION_CANCELLED,
  * in which case you should avoid showing an error dialog to the user.
@@ -917,45 +2050,125 @@ oobs_object_authenticate (OobsObject *object,
   DBusConnection    *connection;
   DBusMessage       *message;
   DBusMessage       *reply;
-  DBusMessageIter   iter;
   gboolean result;
 
   g_return_val_if_fail (OOBS_IS_OBJECT (object), FALSE);
 
   priv = OOBS_OBJECT_GET_PRIVATE (object);
 
-  message = dbus_message_new_method_call (OOBS_DBUS_DESTINATION, priv->path,
-                                          "org.freedesktop.SystemToolsBackends.Authentication",
-                                          "authenticate");
+  if (_oobs_session_is_authorized (priv->session,
+				   oobs_session_get_authentication_action (priv->session)))
+    return TRUE;
 
-  if (!oobs_session_get_connected (priv->session))
+  if (!_oobs_session_ensure_connected (priv->session))
     {
       g_warning ("Could not send message, OobsSession hasn't connected to the bus");
       return FALSE;
     }
 
+  message = create_authenticate_message (object);
   connection = _oobs_session_get_connection_bus (priv->session);
   reply = dbus_connection_send_with_reply_and_block (connection, message, -1, &priv->dbus_error);
+  dbus_message_unref (message);
 
-  if (dbus_error_is_set (&priv->dbus_error))
+  result = get_authenticate_reply (object, reply, &priv->dbus_error, error);
+
+  if (reply)
+    dbus_message_unref (reply);
+
+  return result;
+}
+
+/**
+ * oobs_object_authenticate_async:
+ * @object: An #OobsObject.
+ * @func: An #OobsObjectAuthenticateFunc.
+ * @data: User data to pass to @func.
+ *
+ * Asynchronous version of oobs_object_authenticate(), @func will be
+ * called from the main loop once the backends have answered. If the
+ * action required by @object was authorized recently, see
+ * oobs_session_set_authorization_timeout(), the backends aren't
+ * contacted again.
+ *
+ * Return Value: #OOBS_RESULT_OK if the authentication is in progress,
+ *               #OOBS_RESULT_ERROR if it could not be started, @func
+ *               won't be called then.
+ **/
+OobsResult
+oobs_object_authenticate_async (OobsObject                 *object,
+				OobsObjectAuthenticateFunc  func,
+				gpointer                    data)
+{
+  OobsObjectPrivate *priv;
+  OobsObjectAuthenticateData *auth_data;
+  DBusConnection  *connection;
+  DBusMessage     *message;
+  DBusPendingCall *call;
+
+  g_return_val_if_fail (OOBS_IS_OBJECT (object), OOBS_RESULT_ERROR);
+
+  priv = OOBS_OBJECT_GET_PRIVATE (object);
+
+  auth_data = g_new0 (OobsObjectAuthenticateData, 1);
+  auth_data->object = g_object_ref (object);
+  auth_data->func = func;
+  auth_data->data = data;
+
+  if (_oobs_session_is_authorized (priv->session,
+				   oobs_session_get_authentication_action (priv->session)))
     {
-      if (dbus_error_has_name (&priv->dbus_error,
-                               "org.freedesktop.SystemToolsBackends.AuthenticationCancelled"))
-	g_set_error_literal (error, OOBS_ERROR,
-	                     OOBS_ERROR_AUTHENTICATION_CANCELLED,
-	                     priv->dbus_error.message);
-      else
-	g_set_error_literal (error, OOBS_ERROR,
-	                     OOBS_ERROR_AUTHENTICATION_FAILED,
-	                     priv->dbus_error.message);
+      g_idle_add (authenticate_cached_idle, auth_data);
+      return OOBS_RESULT_OK;
+    }
 
-      dbus_error_free (&priv->dbus_error);
-      return FALSE;
+  if (!_oobs_session_ensure_connected (priv->session))
+    {
+      g_warning ("Could not send message, OobsSession hasn't connected to the bus");
+      free_authenticate_data (auth_data);
+      return OOBS_RESULT_ERROR;
     }
 
-  dbus_message_iter_init (reply, &iter);
-  result = utils_get_boolean (&iter);
+  /* user interaction may take a while, don't time out */
+  message = create_authenticate_message (object);
 
-  return result;
+#ifdef HAVE_GDBUS
+  /* the libdbus connection isn't dispatched from the main loop then */
+  if (get_gdbus_connection (object))
+    {
+      GDBusMessage *gdbus_message;
+
+      gdbus_message = to_gdbus_message (message);
+      dbus_message_unref (message);
+
+      if (!gdbus_message)
+	{
+	  free_authenticate_data (auth_data);
+	  return OOBS_RESULT_ERROR;
+	}
+
+      g_dbus_connection_send_message_with_reply (get_gdbus_connection (object),
+						 gdbus_message,
+						 G_DBUS_SEND_MESSAGE_FLAGS_NONE, G_MAXINT,
+						 NULL, NULL, gdbus_authenticate_async_cb, auth_data);
+      g_object_unref (gdbus_message);
+
+      return OOBS_RESULT_OK;
+    }
+#endif
 
+  connection = _oobs_session_get_connection_bus (priv->session);
+
+  if (!dbus_connection_send_with_reply (connection, message, &call, INT_MAX) || !call)
+    {
+      g_warning ("Could not send the authentication request to the backends");
+      dbus_message_unref (message);
+      free_authenticate_data (auth_data);
+      return OOBS_RESULT_ERROR;
+    }
+
+  dbus_pending_call_set_notify (call, authenticate_async_cb, auth_data, NULL);
+  dbus_message_unref (message);
+
+  return OOBS_RESULT_OK;
 }
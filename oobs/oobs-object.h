@@ -25,6 +25,7 @@ G_BEGIN_DECLS
 
 #include <glib-object.h>
 #include "oobs-result.h"
+#include "oobs-session.h"
 
 #define OOBS_TYPE_OBJECT         (oobs_object_get_type ())
 #define OOBS_OBJECT(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), OOBS_TYPE_OBJECT, OobsObject))
@@ -66,12 +67,21 @@ typedef void (*OobsObjectAsyncFunc) (OobsObject *object,
 				     OobsResult  result,
 				     gpointer    data);
 
+typedef void (*OobsObjectAuthenticateFunc) (OobsObject   *object,
+					    gboolean      authenticated,
+					    const GError *error,
+					    gpointer      data);
+
 GType oobs_object_get_type (void);
 
 OobsResult  oobs_object_commit       (OobsObject          *object);
 OobsResult  oobs_object_commit_async (OobsObject          *object,
 				      OobsObjectAsyncFunc  func,
 				      gpointer             data);
+OobsResult  oobs_object_commit_async_full (OobsObject          *object,
+					   OobsRequestPriority  priority,
+					   OobsObjectAsyncFunc  func,
+					   gpointer             data);
 
 OobsResult  oobs_object_add          (OobsObject          *object);
 OobsResult  oobs_object_add_async    (OobsObject          *object,
@@ -87,13 +97,21 @@ OobsResult  oobs_object_update       (OobsObject          *object);
 OobsResult  oobs_object_update_async (OobsObject          *object,
 				      OobsObjectAsyncFunc  func,
 				      gpointer             data);
+OobsResult  oobs_object_update_async_full (OobsObject          *object,
+					   OobsRequestPriority  priority,
+					   OobsObjectAsyncFunc  func,
+					   gpointer             data);
 
 void        oobs_object_process_requests (OobsObject *object);
+
 gboolean    oobs_object_has_updated      (OobsObject *object);
 void        oobs_object_ensure_update    (OobsObject *object);
 
 gboolean    oobs_object_authenticate (OobsObject *object,
                                       GError    **error);
+OobsResult  oobs_object_authenticate_async (OobsObject                 *object,
+					    OobsObjectAuthenticateFunc  func,
+					    gpointer                    data);
 
 
 G_END_DECLS
@@ -22,12 +22,13 @@
 #include <glib-object.h>
 #include <string.h>
 #include <unistd.h>
+#include <pwd.h>
 
 #include "oobs-object.h"
 #include "oobs-object-private.h"
 #include "oobs-selfconfig.h"
-#include "oobs-usersconfig.h"
 #include "oobs-user.h"
+#include "oobs-user-private.h"
 #include "utils.h"
 
 /**
@@ -49,7 +50,6 @@ struct _OobsSelfConfigPrivate
 
 static void oobs_self_config_class_init  (OobsSelfConfigClass *class);
 static void oobs_self_config_init        (OobsSelfConfig      *config);
-static void oobs_self_config_constructed (GObject             *object);
 static void oobs_self_config_finalize    (GObject             *object);
 
 static void oobs_self_config_update             (OobsObject   *object);
@@ -66,13 +66,15 @@ oobs_self_config_class_init (OobsSelfConfigClass *class)
   GObjectClass *object_class = G_OBJECT_CLASS (class);
   OobsObjectClass *oobs_object_class = OOBS_OBJECT_CLASS (class);
 
-  object_class->constructed  = oobs_self_config_constructed;
   object_class->finalize     = oobs_self_config_finalize;
 
   oobs_object_class->commit  = oobs_self_config_commit;
   oobs_object_class->update  = oobs_self_config_update;
   oobs_object_class->get_update_message = oobs_self_config_get_update_message;
 
+  /* UID, GECOS fields, locale and location */
+  _oobs_object_class_set_reply_signature (oobs_object_class, "uasss");
+
   g_type_class_add_private (object_class,
 			    sizeof (OobsSelfConfigPrivate));
 }
@@ -90,74 +92,81 @@ oobs_self_config_init (OobsSelfConfig *config)
 }
 
 static void
-oobs_self_config_users_updated (OobsSelfConfig  *self,
-				OobsUsersConfig *users)
+oobs_self_config_finalize (GObject *object)
 {
   OobsSelfConfigPrivate *priv;
-  OobsList *list;
-  OobsListIter iter;
-  gboolean valid;
 
-  priv = self->_priv;
-  list = oobs_users_config_get_users (users);
-  valid = oobs_list_get_iter_first (list, &iter);
+  priv = OOBS_SELF_CONFIG (object)->_priv;
 
   if (priv->user)
-    {
-      g_object_unref (priv->user);
-      priv->user = NULL;
-    }
-
-  while (valid && !priv->user)
-    {
-      OobsUser *user;
-
-      user = OOBS_USER (oobs_list_get (list, &iter));
-
-      if (oobs_user_get_uid (user) == priv->uid)
-	priv->user = g_object_ref (user);
-
-      g_object_unref (user);
-      valid = oobs_list_iter_next (list, &iter);
-    }
-}
+    g_object_unref (priv->user);
 
-static void
-oobs_self_config_constructed (GObject *object)
-{
-  /* stay tuned to users config updates */
-  g_signal_connect_swapped (oobs_users_config_get (), "updated",
-			    G_CALLBACK (oobs_self_config_users_updated), object);
+  G_OBJECT_CLASS (oobs_self_config_parent_class)->finalize (object);
 }
 
+/*
+ * The user is built from the SelfConfig2 reply alone, so the whole
+ * users configuration doesn't need to be loaded. Fields that are
+ * not part of the reply are taken from the local passwd database,
+ * the rest is marked as missing so it's retrieved from the backends
+ * if read, or before the user is committed on its own.
+ */
 static void
-oobs_self_config_finalize (GObject *object)
+oobs_self_config_update (OobsObject *object)
 {
   OobsSelfConfigPrivate *priv;
+  DBusMessageIter iter, gecos_iter;
+  DBusMessage *reply;
+  struct passwd *pw;
+  const gchar *gecos[5] = { NULL, };
+  const gchar *locale;
+  guint32 uid;
+  guint i;
 
   priv = OOBS_SELF_CONFIG (object)->_priv;
+  reply = _oobs_object_get_dbus_message (object);
 
-  if (priv->user)
-    g_object_unref (priv->user);
+  dbus_message_iter_init (reply, &iter);
+  uid = utils_get_uint (&iter);
 
-  G_OBJECT_CLASS (oobs_self_config_parent_class)->finalize (object);
-}
+  /* GECOS fields */
+  dbus_message_iter_recurse (&iter, &gecos_iter);
 
-static void
-oobs_self_config_update (OobsObject *object)
-{
-  OobsObject *users_config;
+  for (i = 0; i < G_N_ELEMENTS (gecos) &&
+	 dbus_message_iter_get_arg_type (&gecos_iter) == DBUS_TYPE_STRING; i++)
+    gecos[i] = utils_get_string (&gecos_iter);
+
+  dbus_message_iter_next (&iter);
+  locale = utils_get_string (&iter);
+
+  if (!priv->user)
+    {
+      pw = getpwuid (uid);
 
-  /* We don't actually need to update, since we joint point to an OobsUser */
+      if (!pw || !pw->pw_name || !*pw->pw_name)
+	return;
 
-  users_config = oobs_users_config_get ();
+      priv->user = oobs_user_new (pw->pw_name);
+      g_object_set (priv->user,
+		    "home-directory", pw->pw_dir,
+		    "shell", pw->pw_shell,
+		    NULL);
+
+      _oobs_user_set_gid (priv->user, pw->pw_gid);
+      _oobs_user_set_missing_fields (priv->user,
+				     OOBS_USER_FIELD_PASSWORD_FLAGS |
+				     OOBS_USER_FIELD_HOME);
+    }
 
-  /* just update user if the users object was already
-   * updated, update will be forced later if required
-   */
-  if (oobs_object_has_updated (users_config))
-    oobs_self_config_users_updated (OOBS_SELF_CONFIG (object),
-				    OOBS_USERS_CONFIG (users_config));
+  g_object_set (priv->user,
+		"uid", uid,
+		"full-name", gecos[0],
+		"room-number", gecos[1],
+		"work-phone", gecos[2],
+		"home-phone", gecos[3],
+		"other-data", gecos[4],
+		"locale", locale,
+		NULL);
 }
 
 static void
@@ -243,7 +252,11 @@ oobs_self_config_get (void)
  * oobs_self_config_get_user:
  * @config: An #OobsSelfConfig.
  * 
- * Returns the #OobsUser that represents the requester user.
+ * Returns the #OobsUser that represents the requester user. This
+ * object is not the one found in the #OobsUsersConfig list, changes
+ * to it are meant to be committed through @config. Committing it on its
+ * own retrieves first the fields SelfConfig2 doesn't provide, like the
+ * password flags, so they aren't overwritten.
  * 
  * Return Value: An #OobsUser, you must not reference this object.
  **/
@@ -282,7 +295,8 @@ oobs_self_config_is_user_self (OobsSelfConfig *config,
   oobs_object_ensure_update (OOBS_OBJECT (config));
   priv = config->_priv;
 
-  return (priv->user == user);
+  /* priv->user isn't shared with OobsUsersConfig, compare UIDs */
+  return (priv->user == user || oobs_user_get_uid (user) == priv->uid);
 }
 
 
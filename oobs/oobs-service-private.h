@@ -36,6 +36,10 @@ gboolean     _oobs_create_dbus_struct_from_service     (OobsService     *service
                                                         DBusMessage     *message,
                                                         DBusMessageIter *array_iter);
 
+void         _oobs_service_set_row                     (OobsService     *service,
+                                                        gint             row);
+gint         _oobs_service_get_row                     (OobsService     *service);
+
 G_END_DECLS
 
 #endif /* __OOBS_SERVICE_PRIVATE_H */
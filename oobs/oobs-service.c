@@ -37,17 +37,30 @@
 #define OOBS_SERVICE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_SERVICE, OobsServicePrivate))
 
 typedef struct _OobsServicePrivate  OobsServicePrivate;
-typedef struct _OobsServiceRunlevel OobsServiceRunlevel;
 
-struct _OobsServiceRunlevel {
-  guint status;
-  guint priority;
-};
-	
 struct _OobsServicePrivate {
   OobsServicesConfig *config;
   gchar *name;
-  GHashTable *runlevels_config;
+
+  /* row in the OobsServicesConfig runlevels matrix, -1 if none */
+  gint row;
+};
+
+/* Runlevel configuration of a service, as exchanged with the backends */
+typedef struct {
+  gchar *runlevel;
+  gint   status;
+  gint   priority;
+} ServiceRunlevel;
+
+static const UtilsField service_fields[] = {
+  { UTILS_FIELD_STRING, NULL, G_STRUCT_OFFSET (OobsServicePrivate, name), 0, 0 }
+};
+
+static const UtilsField runlevel_fields[] = {
+  { UTILS_FIELD_STRING, NULL, G_STRUCT_OFFSET (ServiceRunlevel, runlevel), 0, 0 },
+  { UTILS_FIELD_INT,    NULL, G_STRUCT_OFFSET (ServiceRunlevel, status),   0, 0 },
+  { UTILS_FIELD_INT,    NULL, G_STRUCT_OFFSET (ServiceRunlevel, priority), 0, 0 }
 };
 
 static void oobs_service_class_init (OobsServiceClass *class);
@@ -111,8 +124,7 @@ oobs_service_init (OobsService *service)
 
   priv->config = OOBS_SERVICES_CONFIG (oobs_services_config_get ());
   priv->name = NULL;
-  priv->runlevels_config = g_hash_table_new_full (NULL, NULL, NULL,
-						  (GDestroyNotify) g_free);
+  priv->row = -1;
   service->_priv = priv;
 }
 
@@ -163,7 +175,6 @@ oobs_service_finalize (GObject *object)
   if (priv)
     {
       g_free (priv->name);
-      g_hash_table_unref (priv->runlevels_config);
     }
 
   if (G_OBJECT_CLASS (oobs_service_parent_class)->finalize)
@@ -218,17 +229,33 @@ oobs_service_get_update_message (OobsObject *object)
 static void
 oobs_service_update (OobsObject *object)
 {
-  OobsServicePrivate *priv;
   DBusMessage     *reply;
-  DBusMessageIter  iter, elem_iter;
+  DBusMessageIter  iter;
 
-  priv  = OOBS_SERVICE (object)->_priv;
   reply = _oobs_object_get_dbus_message (object);
 
   dbus_message_iter_init (reply, &iter);
 
   _oobs_service_create_from_dbus_reply (OOBS_SERVICE (object),
-                                        reply, elem_iter);
+                                        reply, iter);
+}
+
+static void
+set_runlevel_configuration (OobsService          *service,
+                            OobsServicesRunlevel *runlevel,
+                            OobsServiceStatus     status,
+                            gint                  priority)
+{
+  OobsServicePrivate *priv;
+
+  priv = service->_priv;
+
+  /* services not created by OobsServicesConfig get a row on first use */
+  if (priv->row < 0)
+    _oobs_services_config_add_service (priv->config, service);
+
+  _oobs_services_config_set_runlevel_configuration (priv->config, priv->row,
+                                                    runlevel, status, priority);
 }
 
 static void
@@ -239,27 +266,25 @@ create_service_runlevels_from_dbus_reply (OobsService        *service,
   OobsServicePrivate *priv;
   DBusMessageIter runlevel_iter;
   OobsServicesRunlevel *rl;
-  OobsServiceStatus status;
-  const gchar *runlevel;
-  gint priority;
+  ServiceRunlevel entry = { 0, };
 
   priv = service->_priv;
 
   while (dbus_message_iter_get_arg_type (&struct_iter) == DBUS_TYPE_STRUCT)
     {
       dbus_message_iter_recurse (&struct_iter, &runlevel_iter);
+      utils_decode_fields (&runlevel_iter, runlevel_fields,
+			   G_N_ELEMENTS (runlevel_fields), 0, &entry, NULL);
 
-      runlevel = utils_get_string (&runlevel_iter);
-      status = utils_get_int (&runlevel_iter);
-      priority = utils_get_int (&runlevel_iter);
-
-      rl = _oobs_services_config_get_runlevel (priv->config, runlevel);
+      rl = (entry.runlevel) ? _oobs_services_config_get_runlevel (priv->config, entry.runlevel) : NULL;
 
       if (rl)
-	oobs_service_set_runlevel_configuration (service, rl, status, priority);
+	set_runlevel_configuration (service, rl, entry.status, entry.priority);
 
       dbus_message_iter_next (&struct_iter);
     }
+
+  g_free (entry.runlevel);
 }
 
 OobsService*
@@ -275,10 +300,14 @@ _oobs_service_create_from_dbus_reply (OobsService        *service,
   name = utils_get_string (&iter);
 
   if (!service)
-    service = g_object_new (OOBS_TYPE_SERVICE,
-                            "remote-object", SERVICE_REMOTE_OBJECT,
-                            "name", name,
-                            NULL);
+    {
+      service = g_object_new (OOBS_TYPE_SERVICE,
+                              "remote-object", SERVICE_REMOTE_OBJECT,
+                              "name", name,
+                              NULL);
+      _oobs_services_config_add_service (OOBS_SERVICES_CONFIG (oobs_services_config_get ()),
+                                         service);
+    }
 
   dbus_message_iter_recurse (&iter, &runlevels_iter);
   create_service_runlevels_from_dbus_reply (OOBS_SERVICE (service),
@@ -295,8 +324,8 @@ create_dbus_struct_from_service_runlevels (OobsService     *service,
 {
   DBusMessageIter runlevels_iter, struct_iter;
   OobsServicesRunlevel *runlevel;
+  ServiceRunlevel entry;
   OobsServiceStatus status;
-  gint priority;
 
   dbus_message_iter_open_container (iter,
 				    DBUS_TYPE_ARRAY,
@@ -312,17 +341,17 @@ create_dbus_struct_from_service_runlevels (OobsService     *service,
       runlevel = runlevels->data;
       runlevels = runlevels->next;
 
-      oobs_service_get_runlevel_configuration (service, runlevel, &status, &priority);
+      oobs_service_get_runlevel_configuration (service, runlevel, &status, &entry.priority);
 
       if (status == OOBS_SERVICE_IGNORE)
 	continue;
 
-      dbus_message_iter_open_container (&runlevels_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
-
-      utils_append_string (&struct_iter, runlevel->name);
-      utils_append_int (&struct_iter, status);
-      utils_append_int (&struct_iter, priority);
+      entry.runlevel = runlevel->name;
+      entry.status = status;
 
+      dbus_message_iter_open_container (&runlevels_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
+      utils_encode_fields (&struct_iter, runlevel_fields,
+			   G_N_ELEMENTS (runlevel_fields), &entry);
       dbus_message_iter_close_container (&runlevels_iter, &struct_iter);
     }
 
@@ -335,27 +364,42 @@ _oobs_create_dbus_struct_from_service (OobsService     *service,
                                        DBusMessage     *message,
                                        DBusMessageIter *array_iter)
 {
+  OobsServicePrivate *priv;
   DBusMessageIter struct_iter;
-  gchar *name;
 
-  g_object_get (G_OBJECT (service),
-		"name", &name,
-		NULL);
-
-  g_return_val_if_fail (name, FALSE);
+  priv = service->_priv;
+  g_return_val_if_fail (priv->name, FALSE);
 
   dbus_message_iter_open_container (array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
 
-  utils_append_string (&struct_iter, name);
+  utils_encode_fields (&struct_iter, service_fields,
+		       G_N_ELEMENTS (service_fields), priv);
   create_dbus_struct_from_service_runlevels (service, runlevels, message, &struct_iter);
 
   dbus_message_iter_close_container (array_iter, &struct_iter);
 
-  g_free (name);
-
   return TRUE;
 }
 
+void
+_oobs_service_set_row (OobsService *service,
+                       gint         row)
+{
+  OobsServicePrivate *priv;
+
+  priv = service->_priv;
+  priv->row = row;
+}
+
+gint
+_oobs_service_get_row (OobsService *service)
+{
+  OobsServicePrivate *priv;
+
+  priv = service->_priv;
+  return priv->row;
+}
+
 /**
  * oobs_service_get_name:
  * @service: An #OobsService.
@@ -393,7 +437,6 @@ oobs_service_set_runlevel_configuration (OobsService          *service,
 					 gint                  priority)
 {
   OobsServicePrivate *priv;
-  OobsServiceRunlevel *service_runlevel;
 
   g_return_if_fail (OOBS_IS_SERVICE (service));
   g_return_if_fail (runlevel != NULL);
@@ -401,21 +444,8 @@ oobs_service_set_runlevel_configuration (OobsService          *service,
 
   priv = service->_priv;
 
-  service_runlevel = g_hash_table_lookup (priv->runlevels_config, runlevel);
-
-  if (!service_runlevel)
-    {
-      service_runlevel = g_new0 (OobsServiceRunlevel, 1);
-      g_hash_table_insert (priv->runlevels_config,
-                           runlevel, service_runlevel);
-    }
-
-  service_runlevel->status = status;
-
-  /* Keep previous priority. If the script was not used previously,
-   * the backends will use a default value. */
-  if (priority != 0)
-    service_runlevel->priority = priority;
+  set_runlevel_configuration (service, runlevel, status, priority);
+  _oobs_services_config_mark_changed (priv->config, priv->row);
 }
 
 /**
@@ -434,18 +464,12 @@ oobs_service_get_runlevel_configuration (OobsService          *service,
 					 gint                 *priority)
 {
   OobsServicePrivate *priv;
-  OobsServiceRunlevel *service_runlevel;
 
   g_return_if_fail (OOBS_IS_SERVICE (service));
   g_return_if_fail (runlevel != NULL);
 
   priv = service->_priv;
 
-  service_runlevel = g_hash_table_lookup (priv->runlevels_config, runlevel);
-
-  if (status)
-    *status = (service_runlevel) ? service_runlevel->status : OOBS_SERVICE_STOP;
-
-  if (priority)
-    *priority = (service_runlevel) ? service_runlevel->priority : 0;
+  _oobs_services_config_get_runlevel_configuration (priv->config, priv->row,
+                                                    runlevel, status, priority);
 }
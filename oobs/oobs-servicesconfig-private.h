@@ -24,10 +24,27 @@
 G_BEGIN_DECLS
 
 #include "oobs-servicesconfig.h"
+#include "oobs-service.h"
 
 OobsServicesRunlevel* _oobs_services_config_get_runlevel (OobsServicesConfig *config,
                                                           const gchar        *runlevel);
 
+void     _oobs_services_config_add_service (OobsServicesConfig   *config,
+                                            OobsService          *service);
+
+void     _oobs_services_config_set_runlevel_configuration (OobsServicesConfig   *config,
+                                                           gint                  row,
+                                                           OobsServicesRunlevel *runlevel,
+                                                           OobsServiceStatus     status,
+                                                           gint                  priority);
+void     _oobs_services_config_mark_changed (OobsServicesConfig   *config,
+                                             gint                  row);
+void     _oobs_services_config_get_runlevel_configuration (OobsServicesConfig   *config,
+                                                           gint                  row,
+                                                           OobsServicesRunlevel *runlevel,
+                                                           OobsServiceStatus    *status,
+                                                           gint                 *priority);
+
 G_END_DECLS
 
 #endif /* __OOBS_SERVICES_CONFIG_PRIVATE_H */
@@ -42,13 +42,48 @@
 #define SERVICES_CONFIG_REMOTE_OBJECT "ServicesConfig"
 #define OOBS_SERVICES_CONFIG_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_SERVICES_CONFIG, OobsServicesConfigPrivate))
 
+/* Number of possible OobsServiceStatus values, each one has its own bitset */
+#define N_STATUS      (OOBS_SERVICE_IGNORE + 1)
+#define BITS_PER_WORD (sizeof (gulong) * 8)
+#define BITSET(priv, column, status) \
+  ((priv)->bitsets + (((column) * N_STATUS) + (status)) * (priv)->n_words)
+
 typedef struct _OobsServicesConfigPrivate OobsServicesConfigPrivate;
+typedef struct _OobsServicesCell          OobsServicesCell;
+
+struct _OobsServicesCell
+{
+  guint8 status;
+  gint   priority;
+};
 
 struct _OobsServicesConfigPrivate
 {
   OobsList *services_list;
   GList *runlevels;
   OobsServicesRunlevel *default_runlevel;
+
+  /* runlevel name -> OobsServicesRunlevel, and
+   * OobsServicesRunlevel -> column in the matrix (plus one) */
+  GHashTable *runlevels_by_name;
+  GHashTable *runlevel_columns;
+  guint n_runlevels;
+
+  /* service x runlevel matrix, a row per service,
+   * rows holds a reference to the OobsService in each row */
+  GPtrArray *rows;
+  guint n_allocated_rows;
+  OobsServicesCell *cells;
+
+  /* a bitset over rows for each runlevel and status */
+  guint n_words;
+  gulong *bitsets;
+
+  /* rows modified since the last successful commit,
+   * and those sent by the commit in progress */
+  gulong *changed;
+  gulong *committing;
+  guint commit_changed_only : 1;
 };
 
 static void oobs_services_config_class_init (OobsServicesConfigClass *class);
@@ -57,6 +92,7 @@ static void oobs_services_config_finalize   (GObject                 *object);
 
 static void oobs_services_config_update     (OobsObject   *object);
 static void oobs_services_config_commit     (OobsObject   *object);
+static void oobs_services_config_committed  (OobsObject   *object);
 
 
 G_DEFINE_TYPE (OobsServicesConfig, oobs_services_config, OOBS_TYPE_OBJECT);
@@ -70,6 +106,7 @@ oobs_services_config_class_init (OobsServicesConfigClass *class)
   object_class->finalize    = oobs_services_config_finalize;
   oobs_object_class->commit = oobs_services_config_commit;
   oobs_object_class->update = oobs_services_config_update;
+  oobs_object_class->committed = oobs_services_config_committed;
 
   g_type_class_add_private (object_class,
 			    sizeof (OobsServicesConfigPrivate));
@@ -85,6 +122,9 @@ oobs_services_config_init (OobsServicesConfig *config)
   priv = OOBS_SERVICES_CONFIG_GET_PRIVATE (config);
 
   priv->services_list = _oobs_list_new (OOBS_TYPE_SERVICE);
+  priv->runlevels_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->runlevel_columns = g_hash_table_new (NULL, NULL);
+  priv->rows = g_ptr_array_new ();
   config->_priv = priv;
 }
 
@@ -95,6 +135,82 @@ free_runlevel (OobsServicesRunlevel *runlevel)
   g_free (runlevel);
 }
 
+/* Detaches all services from the matrix, this has to
+ * be done before the runlevels list is modified */
+static void
+clear_matrix (OobsServicesConfig *config)
+{
+  OobsServicesConfigPrivate *priv;
+  OobsService *service;
+  guint i;
+
+  priv = config->_priv;
+
+  for (i = 0; i < priv->rows->len; i++)
+    {
+      service = g_ptr_array_index (priv->rows, i);
+      _oobs_service_set_row (service, -1);
+      g_object_unref (service);
+    }
+
+  g_ptr_array_set_size (priv->rows, 0);
+
+  g_free (priv->cells);
+  priv->cells = NULL;
+  priv->n_allocated_rows = 0;
+
+  g_free (priv->bitsets);
+  priv->bitsets = NULL;
+  priv->n_words = 0;
+
+  g_free (priv->changed);
+  priv->changed = NULL;
+
+  g_free (priv->committing);
+  priv->committing = NULL;
+}
+
+static void
+grow_matrix (OobsServicesConfig *config)
+{
+  OobsServicesConfigPrivate *priv;
+  gulong *bitsets;
+  guint n_allocated_rows, n_words, i;
+
+  priv = config->_priv;
+
+  n_allocated_rows = MAX (32, priv->n_allocated_rows * 2);
+  n_words = (n_allocated_rows + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+  priv->cells = g_renew (OobsServicesCell, priv->cells,
+                         n_allocated_rows * priv->n_runlevels);
+
+  /* the bitsets stride changes, copy them one by one */
+  bitsets = g_new0 (gulong, priv->n_runlevels * N_STATUS * n_words);
+
+  if (priv->bitsets)
+    {
+      for (i = 0; i < priv->n_runlevels * N_STATUS; i++)
+        memcpy (bitsets + (i * n_words),
+                priv->bitsets + (i * priv->n_words),
+                priv->n_words * sizeof (gulong));
+
+      g_free (priv->bitsets);
+    }
+
+  priv->changed = g_renew (gulong, priv->changed, n_words);
+  memset (priv->changed + priv->n_words, 0,
+          (n_words - priv->n_words) * sizeof (gulong));
+
+  priv->committing = g_renew (gulong, priv->committing, n_words);
+  memset (priv->committing + priv->n_words, 0,
+          (n_words - priv->n_words) * sizeof (gulong));
+
+  priv->bitsets = bitsets;
+  priv->n_words = n_words;
+  priv->n_allocated_rows = n_allocated_rows;
+}
+
 static void
 oobs_services_config_finalize (GObject *object)
 {
@@ -109,6 +225,11 @@ oobs_services_config_finalize (GObject *object)
       if (priv->services_list)
 	g_object_unref (priv->services_list);
 
+      clear_matrix (OOBS_SERVICES_CONFIG (object));
+      g_ptr_array_free (priv->rows, TRUE);
+      g_hash_table_destroy (priv->runlevels_by_name);
+      g_hash_table_destroy (priv->runlevel_columns);
+
       if (priv->runlevels)
 	{
 	  g_list_foreach (priv->runlevels, (GFunc) free_runlevel, NULL);
@@ -147,6 +268,10 @@ create_runlevels_list_from_dbus_reply (OobsObject      *object,
 
   priv = OOBS_SERVICES_CONFIG (object)->_priv;
 
+  g_hash_table_remove_all (priv->runlevels_by_name);
+  g_hash_table_remove_all (priv->runlevel_columns);
+  priv->n_runlevels = 0;
+
   if (priv->runlevels)
   {
     g_list_foreach (priv->runlevels, (GFunc) free_runlevel, NULL);
@@ -163,36 +288,139 @@ create_runlevels_list_from_dbus_reply (OobsObject      *object,
       runlevel->role = runlevel_to_role (runlevel->name);
 
       priv->runlevels = g_list_prepend (priv->runlevels, runlevel);
+
+      g_hash_table_insert (priv->runlevels_by_name, runlevel->name, runlevel);
+      g_hash_table_insert (priv->runlevel_columns, runlevel,
+                           GUINT_TO_POINTER (++priv->n_runlevels));
     }
 
   priv->runlevels = g_list_reverse (priv->runlevels);
 }
 
+/* Returns the matrix column for the runlevel, or -1 if it
+ * doesn't belong to the current configuration */
+static gint
+get_runlevel_column (OobsServicesConfigPrivate *priv,
+                     OobsServicesRunlevel      *runlevel)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (priv->runlevel_columns, runlevel)) - 1;
+}
+
 OobsServicesRunlevel*
 _oobs_services_config_get_runlevel (OobsServicesConfig *config,
                                     const gchar        *runlevel)
 {
   OobsServicesConfigPrivate *priv;
-  OobsServicesRunlevel *rl;
-  GList *list;
 
   if (!runlevel)
     return NULL;
 
   priv = config->_priv;
-  list = priv->runlevels;
 
-  while (list)
-    {
-      rl = list->data;
+  return g_hash_table_lookup (priv->runlevels_by_name, runlevel);
+}
+
+void
+_oobs_services_config_add_service (OobsServicesConfig *config,
+                                   OobsService        *service)
+{
+  OobsServicesConfigPrivate *priv;
+  OobsServicesCell *cell;
+  gulong *bitset;
+  guint row, i;
+
+  priv = config->_priv;
+
+  if (priv->rows->len == priv->n_allocated_rows)
+    grow_matrix (config);
+
+  row = priv->rows->len;
+  g_ptr_array_add (priv->rows, g_object_ref (service));
+  _oobs_service_set_row (service, row);
 
-      if (strcmp (rl->name, runlevel) == 0)
-	return rl;
+  /* services are stopped by default */
+  for (i = 0; i < priv->n_runlevels; i++)
+    {
+      cell = &priv->cells[(row * priv->n_runlevels) + i];
+      cell->status = OOBS_SERVICE_STOP;
+      cell->priority = 0;
 
-      list = list->next;
+      bitset = BITSET (priv, i, OOBS_SERVICE_STOP);
+      bitset[row / BITS_PER_WORD] |= 1UL << (row % BITS_PER_WORD);
     }
+}
+
+void
+_oobs_services_config_set_runlevel_configuration (OobsServicesConfig   *config,
+                                                  gint                  row,
+                                                  OobsServicesRunlevel *runlevel,
+                                                  OobsServiceStatus     status,
+                                                  gint                  priority)
+{
+  OobsServicesConfigPrivate *priv;
+  OobsServicesCell *cell;
+  gulong *bitset, mask;
+  gint column;
+
+  priv = config->_priv;
+  column = get_runlevel_column (priv, runlevel);
+
+  g_return_if_fail (column >= 0);
+  g_return_if_fail (row >= 0 && (guint) row < priv->rows->len);
+  g_return_if_fail (status < N_STATUS);
+
+  cell = &priv->cells[(row * priv->n_runlevels) + column];
+  mask = 1UL << (row % BITS_PER_WORD);
+
+  bitset = BITSET (priv, column, cell->status);
+  bitset[row / BITS_PER_WORD] &= ~mask;
+
+  bitset = BITSET (priv, column, status);
+  bitset[row / BITS_PER_WORD] |= mask;
+
+  cell->status = status;
+
+  /* Keep previous priority. If the script was not used previously,
+   * the backends will use a default value. */
+  if (priority != 0)
+    cell->priority = priority;
+}
+
+void
+_oobs_services_config_mark_changed (OobsServicesConfig *config,
+                                    gint                row)
+{
+  OobsServicesConfigPrivate *priv;
+
+  priv = config->_priv;
+
+  g_return_if_fail (row >= 0 && (guint) row < priv->rows->len);
+
+  priv->changed[row / BITS_PER_WORD] |= 1UL << (row % BITS_PER_WORD);
+}
+
+void
+_oobs_services_config_get_runlevel_configuration (OobsServicesConfig   *config,
+                                                  gint                  row,
+                                                  OobsServicesRunlevel *runlevel,
+                                                  OobsServiceStatus    *status,
+                                                  gint                 *priority)
+{
+  OobsServicesConfigPrivate *priv;
+  OobsServicesCell *cell = NULL;
+  gint column;
+
+  priv = config->_priv;
+  column = get_runlevel_column (priv, runlevel);
+
+  if (column >= 0 && row >= 0 && (guint) row < priv->rows->len)
+    cell = &priv->cells[(row * priv->n_runlevels) + column];
+
+  if (status)
+    *status = (cell) ? cell->status : OOBS_SERVICE_STOP;
 
-  return NULL;
+  if (priority)
+    *priority = (cell) ? cell->priority : 0;
 }
 
 static void
@@ -212,6 +440,7 @@ oobs_services_config_update (OobsObject *object)
 
   /* First of all, free the previous config */
   oobs_list_clear (priv->services_list);
+  clear_matrix (OOBS_SERVICES_CONFIG (object));
 
   dbus_message_iter_init (reply, &iter);
 
@@ -236,6 +465,10 @@ oobs_services_config_update (OobsObject *object)
       dbus_message_iter_next (&elem_iter);
     }
 
+  /* the freshly read configuration has no pending changes */
+  if (priv->changed)
+    memset (priv->changed, 0, priv->n_words * sizeof (gulong));
+
   _oobs_list_set_locked (priv->services_list, TRUE);
 }
 
@@ -248,6 +481,8 @@ oobs_services_config_commit (OobsObject *object)
   OobsListIter list_iter;
   gboolean valid, correct;
   GObject *service;
+  gulong word;
+  guint i;
 
   correct = TRUE;
   priv = OOBS_SERVICES_CONFIG (object)->_priv;
@@ -273,16 +508,35 @@ oobs_services_config_commit (OobsObject *object)
 				    DBUS_STRUCT_END_CHAR_AS_STRING,
 				    &array_iter);
 
-  valid = oobs_list_get_iter_first (priv->services_list, &list_iter);
-
-  while (correct && valid)
+  if (priv->commit_changed_only)
     {
-      service = oobs_list_get (priv->services_list, &list_iter);
-      correct = _oobs_create_dbus_struct_from_service (OOBS_SERVICE (service),
-                                                       priv->runlevels,
-                                                       message, &array_iter);
-      g_object_unref (service);
-      valid = oobs_list_iter_next (priv->services_list, &list_iter);
+      /* only send the services modified since the last commit,
+       * the backends leave alone those that aren't listed */
+      for (i = 0; correct && i < priv->n_words; i++)
+        {
+          for (word = priv->changed[i]; correct && word; word &= word - 1)
+            {
+              service = g_ptr_array_index (priv->rows,
+                                           (i * BITS_PER_WORD) + g_bit_nth_lsf (word, -1));
+              correct = _oobs_create_dbus_struct_from_service (OOBS_SERVICE (service),
+                                                               priv->runlevels,
+                                                               message, &array_iter);
+            }
+        }
+    }
+  else
+    {
+      valid = oobs_list_get_iter_first (priv->services_list, &list_iter);
+
+      while (correct && valid)
+        {
+          service = oobs_list_get (priv->services_list, &list_iter);
+          correct = _oobs_create_dbus_struct_from_service (OOBS_SERVICE (service),
+                                                           priv->runlevels,
+                                                           message, &array_iter);
+          g_object_unref (service);
+          valid = oobs_list_iter_next (priv->services_list, &list_iter);
+        }
     }
 
   dbus_message_iter_close_container (&iter, &array_iter);
@@ -292,6 +546,27 @@ oobs_services_config_commit (OobsObject *object)
       /* malformed data, unset the message */
       _oobs_object_set_dbus_message (object, NULL);
     }
+  else if (priv->changed)
+    {
+      /* the changes stay pending until the backends accept them */
+      memcpy (priv->committing, priv->changed, priv->n_words * sizeof (gulong));
+    }
+}
+
+static void
+oobs_services_config_committed (OobsObject *object)
+{
+  OobsServicesConfigPrivate *priv;
+  guint i;
+
+  priv = OOBS_SERVICES_CONFIG (object)->_priv;
+
+  /* rows modified while the commit was in flight are still pending */
+  for (i = 0; i < priv->n_words; i++)
+    {
+      priv->changed[i] &= ~priv->committing[i];
+      priv->committing[i] = 0;
+    }
 }
 
 /**
@@ -381,3 +656,142 @@ oobs_services_config_get_default_runlevel (OobsServicesConfig *config)
 
   return priv->default_runlevel;
 }
+
+/**
+ * oobs_services_config_get_services_with_status:
+ * @config: An #OobsServicesConfig.
+ * @runlevel: An #OobsServicesRunlevel.
+ * @status: An #OobsServiceStatus.
+ *
+ * Returns the services that have the given status in @runlevel, i.e.
+ * all the services enabled in a runlevel can be retrieved by passing
+ * #OOBS_SERVICE_START. Services are returned in the same order than
+ * in oobs_services_config_get_services().
+ *
+ * Return Value: list of #OobsService. The list must be freed with
+ *               g_list_free ();
+ **/
+GList*
+oobs_services_config_get_services_with_status (OobsServicesConfig   *config,
+                                               OobsServicesRunlevel *runlevel,
+                                               gint                  status)
+{
+  OobsServicesConfigPrivate *priv;
+  GList *services = NULL;
+  gulong *bitset, word;
+  gint column, bit;
+  guint i;
+
+  g_return_val_if_fail (OOBS_IS_SERVICES_CONFIG (config), NULL);
+  g_return_val_if_fail (runlevel != NULL, NULL);
+  g_return_val_if_fail (status >= 0 && status < N_STATUS, NULL);
+
+  priv = config->_priv;
+  column = get_runlevel_column (priv, runlevel);
+
+  if (column < 0)
+    return NULL;
+
+  bitset = BITSET (priv, column, status);
+
+  for (i = 0; i < priv->n_words; i++)
+    {
+      word = bitset[i];
+
+      while (word)
+        {
+          bit = g_bit_nth_lsf (word, -1);
+          services = g_list_prepend (services,
+                                     g_ptr_array_index (priv->rows, (i * BITS_PER_WORD) + bit));
+          word &= word - 1;
+        }
+    }
+
+  return g_list_reverse (services);
+}
+
+/**
+ * oobs_services_config_count_services_with_status:
+ * @config: An #OobsServicesConfig.
+ * @runlevel: An #OobsServicesRunlevel.
+ * @status: An #OobsServiceStatus.
+ *
+ * Returns the number of services that have the given status in @runlevel.
+ *
+ * Return Value: the number of services.
+ **/
+guint
+oobs_services_config_count_services_with_status (OobsServicesConfig   *config,
+                                                 OobsServicesRunlevel *runlevel,
+                                                 gint                  status)
+{
+  OobsServicesConfigPrivate *priv;
+  gulong *bitset, word;
+  guint i, count = 0;
+  gint column;
+
+  g_return_val_if_fail (OOBS_IS_SERVICES_CONFIG (config), 0);
+  g_return_val_if_fail (runlevel != NULL, 0);
+  g_return_val_if_fail (status >= 0 && status < N_STATUS, 0);
+
+  priv = config->_priv;
+  column = get_runlevel_column (priv, runlevel);
+
+  if (column < 0)
+    return 0;
+
+  bitset = BITSET (priv, column, status);
+
+  for (i = 0; i < priv->n_words; i++)
+    {
+      for (word = bitset[i]; word; word &= word - 1)
+        count++;
+    }
+
+  return count;
+}
+
+/**
+ * oobs_services_config_apply_changes:
+ * @config: An #OobsServicesConfig.
+ * @changes: an array of #OobsServicesChange.
+ * @n_changes: number of elements in @changes.
+ *
+ * Sets the runlevel configuration of several services at once, as
+ * oobs_service_set_runlevel_configuration() would do for each element
+ * in @changes, and commits them to the system in a single request.
+ * Only the services modified since the last commit are sent.
+ *
+ * Return Value: an #OobsResult enum with the error code.
+ **/
+OobsResult
+oobs_services_config_apply_changes (OobsServicesConfig       *config,
+                                    const OobsServicesChange *changes,
+                                    guint                     n_changes)
+{
+  OobsServicesConfigPrivate *priv;
+  OobsResult result;
+  guint i;
+
+  g_return_val_if_fail (OOBS_IS_SERVICES_CONFIG (config), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (changes != NULL || n_changes == 0, OOBS_RESULT_MALFORMED_DATA);
+
+  for (i = 0; i < n_changes; i++)
+    g_return_val_if_fail (OOBS_IS_SERVICE (changes[i].service), OOBS_RESULT_MALFORMED_DATA);
+
+  priv = config->_priv;
+
+  for (i = 0; i < n_changes; i++)
+    oobs_service_set_runlevel_configuration (changes[i].service,
+                                             changes[i].runlevel,
+                                             changes[i].status,
+                                             changes[i].priority);
+
+  /* the changes are only cleared from the pending
+   * set once committed, a failed commit retries them */
+  priv->commit_changed_only = TRUE;
+  result = oobs_object_commit (OOBS_OBJECT (config));
+  priv->commit_changed_only = FALSE;
+
+  return result;
+}
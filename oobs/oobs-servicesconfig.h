@@ -36,6 +36,7 @@ G_BEGIN_DECLS
 typedef struct _OobsServicesConfig      OobsServicesConfig;
 typedef struct _OobsServicesConfigClass OobsServicesConfigClass;
 typedef struct _OobsServicesRunlevel    OobsServicesRunlevel;
+typedef struct _OobsServicesChange      OobsServicesChange;
 
 typedef enum
 {
@@ -51,6 +52,14 @@ struct _OobsServicesRunlevel
   guint role;
 };
 
+struct _OobsServicesChange
+{
+  struct _OobsService  *service;
+  OobsServicesRunlevel *runlevel;
+  gint status;
+  gint priority;
+};
+
 struct _OobsServicesConfig
 {
   OobsObject parent;
@@ -77,6 +86,17 @@ OobsList*   oobs_services_config_get_services  (OobsServicesConfig *config);
 GList*      oobs_services_config_get_runlevels (OobsServicesConfig *config);
 G_CONST_RETURN OobsServicesRunlevel* oobs_services_config_get_default_runlevel (OobsServicesConfig *config);
 
+GList*      oobs_services_config_get_services_with_status   (OobsServicesConfig   *config,
+                                                             OobsServicesRunlevel *runlevel,
+                                                             gint                  status);
+guint       oobs_services_config_count_services_with_status (OobsServicesConfig   *config,
+                                                             OobsServicesRunlevel *runlevel,
+                                                             gint                  status);
+
+OobsResult  oobs_services_config_apply_changes (OobsServicesConfig       *config,
+                                                const OobsServicesChange *changes,
+                                                guint                     n_changes);
+
 
 G_END_DECLS
 
@@ -30,7 +30,38 @@ G_BEGIN_DECLS
 #define OOBS_DBUS_PATH_PREFIX   "/org/freedesktop/SystemToolsBackends"
 #define OOBS_DBUS_METHOD_PREFIX "org.freedesktop.SystemToolsBackends"
 
+typedef struct _OobsSessionRequest OobsSessionRequest;
+typedef void (*OobsSessionRequestFunc) (OobsSessionRequest *request,
+					gpointer            data);
+
 DBusConnection* _oobs_session_get_connection_bus (OobsSession *session);
+DBusConnection* _oobs_session_get_object_connection (OobsSession *session);
+gboolean        _oobs_session_get_bulk_transfer     (OobsSession *session);
+gboolean        _oobs_session_get_connecting        (OobsSession *session);
+gboolean        _oobs_session_ensure_connected      (OobsSession *session);
+
+gboolean        _oobs_session_is_authorized  (OobsSession *session,
+					      const gchar *action);
+void            _oobs_session_set_authorized (OobsSession *session,
+					      const gchar *action,
+					      gboolean     authorized);
+
+void                _oobs_session_queue_request            (OobsSession            *session,
+							    OobsRequestPriority     priority,
+							    OobsSessionRequestFunc  func,
+							    gpointer                data);
+void                _oobs_session_request_set_pending_call (OobsSessionRequest     *request,
+							    DBusPendingCall        *call);
+void                _oobs_session_request_done             (OobsSession            *session,
+							    OobsSessionRequest     *request);
+void                _oobs_session_wait_request             (OobsSession            *session);
+
+#ifdef HAVE_GDBUS
+#include <gio/gio.h>
+
+GDBusConnection* _oobs_session_get_gdbus_connection        (OobsSession *session);
+GDBusConnection* _oobs_session_get_gdbus_object_connection (OobsSession *session);
+#endif
 
 G_END_DECLS
 
@@ -18,11 +18,13 @@
  * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
  */
 
+#include "config.h"
 #include <dbus/dbus.h>
 #include <dbus/dbus-glib.h>
 #include <dbus/dbus-glib-lowlevel.h>
 #include <glib-object.h>
 #include <glib.h>
+#include <string.h>
 #include "oobs-session.h"
 #include "oobs-session-private.h"
 #include "oobs-object.h"
@@ -38,19 +40,87 @@
 #define PLATFORMS_PATH OOBS_DBUS_PATH_PREFIX "/Platform"
 #define PLATFORMS_INTERFACE OOBS_DBUS_METHOD_PREFIX ".Platform"
 #define POLKIT_ACTION "org.freedesktop.systemtoolsbackends.set"
+#define PEER_PATH OOBS_DBUS_PATH_PREFIX
+#define PEER_INTERFACE OOBS_DBUS_METHOD_PREFIX ".Peer"
+#define DEFAULT_MAX_REQUESTS 32
+#define DEFAULT_AUTHORIZATION_TIMEOUT 300
+#define N_PRIORITIES (OOBS_REQUEST_PRIORITY_BACKGROUND + 1)
 
 typedef struct _OobsSessionPrivate OobsSessionPrivate;
+typedef struct _OobsSessionConnectData OobsSessionConnectData;
+typedef struct _OobsSessionAsyncCallback OobsSessionAsyncCallback;
 
 struct _OobsSessionPrivate
 {
   DBusConnection *connection;
   DBusError       dbus_error;
 
+  /* private connection to the backends, see oobs_session_open_peer_connection() */
+  DBusConnection *peer_connection;
+
+#ifdef HAVE_GDBUS
+  /* used for objects traffic if the GDBus transport is active */
+  GDBusConnection *gdbus_connection;
+  GDBusConnection *gdbus_peer_connection;
+#endif
+
   GList    *session_objects;
-  gboolean  is_authenticated;
+
+  /* see oobs_session_get_async() */
+  guint     connect_started : 1;
+  guint     connecting      : 1;
+  GSList   *connect_callbacks;
+
+  /* expiry time of the authorizations obtained, by action */
+  GHashTable *authorizations;
+  guint       authorization_timeout;
+  gboolean  bulk_transfer;
 
   gchar    *platform;
   GList    *supported_platforms;
+
+  /* Asynchronous requests, see _oobs_session_queue_request().
+   * Each request holds its link in the queue it's on. */
+  GQueue   *queued_requests [N_PRIORITIES];
+  GQueue   *running_requests;
+  guint     n_queued_requests;
+  guint     n_done_requests;
+  guint     max_requests;
+
+  /* time spent queued by the requests sent so far, per priority */
+  gdouble   wait_time [N_PRIORITIES];
+  guint     n_waited [N_PRIORITIES];
+};
+
+/* Filled by open_connections(), possibly in a thread */
+struct _OobsSessionConnectData
+{
+  OobsSession     *session;
+  gboolean         detect_platform;
+
+  DBusConnection  *connection;
+#ifdef HAVE_GDBUS
+  GDBusConnection *gdbus_connection;
+#endif
+  DBusError        error;
+  gchar           *platform;
+};
+
+struct _OobsSessionAsyncCallback
+{
+  OobsSessionAsyncFunc func;
+  gpointer             data;
+};
+
+struct _OobsSessionRequest
+{
+  OobsSessionRequestFunc  func;
+  gpointer                data;
+  DBusPendingCall        *call;
+  GList                   link;
+
+  OobsRequestPriority     priority;
+  gdouble                 queued_time;
 };
 
 static void oobs_session_class_init (OobsSessionClass *class);
@@ -69,12 +139,23 @@ static void oobs_session_get_property (GObject      *object,
 				       GValue       *value,
 				       GParamSpec   *pspec);
 
+static void run_queued_requests (OobsSession *session);
+
 enum
 {
   PROP_0,
   PROP_PLATFORM
 };
 
+enum
+{
+  CONNECTED,
+  QUEUE_DEPTH_CHANGED,
+  LAST_SIGNAL
+};
+
+static guint session_signals [LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (OobsSession, oobs_session, G_TYPE_OBJECT);
 
 static void
@@ -93,28 +174,255 @@ oobs_session_class_init (OobsSessionClass *class)
 							"Name of the platform the session is running on",
 							NULL,
 							G_PARAM_READWRITE));
+  /**
+   * OobsSession::queue-depth-changed:
+   * @session: the object which received the signal.
+   * @depth: number of asynchronous requests waiting to be sent.
+   *
+   * Emitted when asynchronous requests are queued because the
+   * maximum number of requests in flight was reached, and when
+   * queued requests are sent. Callers issuing many requests can
+   * use it to hold back until the queue drains.
+   * See oobs_session_set_max_requests().
+   **/
+  /**
+   * OobsSession::connected:
+   * @session: the object which received the signal.
+   *
+   * Emitted when the connection started by oobs_session_get_async()
+   * has been set up, whether it succeeded or not. Asynchronous requests
+   * made in the meantime are sent from then on.
+   **/
+  session_signals [CONNECTED] =
+    g_signal_new ("connected",
+		  G_OBJECT_CLASS_TYPE (object_class),
+		  G_SIGNAL_RUN_LAST,
+		  0, NULL, NULL,
+		  g_cclosure_marshal_VOID__VOID,
+		  G_TYPE_NONE, 0);
+
+  session_signals [QUEUE_DEPTH_CHANGED] =
+    g_signal_new ("queue-depth-changed",
+		  G_OBJECT_CLASS_TYPE (object_class),
+		  G_SIGNAL_RUN_LAST,
+		  0, NULL, NULL,
+		  g_cclosure_marshal_VOID__UINT,
+		  G_TYPE_NONE, 1, G_TYPE_UINT);
+
   g_type_class_add_private (object_class,
 			    sizeof (OobsSessionPrivate));
 }
 
+#ifdef HAVE_GDBUS
+/*
+ * GDBus is used unless OOBS_DBUS_TRANSPORT=libdbus
+ * is set in the environment, or it fails to connect.
+ */
+static GDBusConnection *
+open_gdbus_connection (void)
+{
+  GDBusConnection *connection;
+  const gchar *transport;
+  GError *error = NULL;
+
+  transport = g_getenv ("OOBS_DBUS_TRANSPORT");
+
+  if (transport && strcmp (transport, "libdbus") == 0)
+    return NULL;
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+
+  if (!connection)
+    {
+      g_warning ("Could not connect to the bus using GDBus, falling back to libdbus: %s",
+		 error->message);
+      g_error_free (error);
+    }
+
+  return connection;
+}
+#endif
+
+static gboolean
+uses_gdbus (OobsSessionPrivate *priv)
+{
+#ifdef HAVE_GDBUS
+  return (priv->gdbus_connection != NULL);
+#else
+  return FALSE;
+#endif
+}
+
+static gchar *
+request_platform (DBusConnection *connection,
+		  DBusError      *error)
+{
+  DBusMessage *message, *reply;
+  DBusMessageIter iter;
+  gchar *platform;
+
+  message = dbus_message_new_method_call (OOBS_DBUS_DESTINATION,
+					  PLATFORMS_PATH,
+					  PLATFORMS_INTERFACE,
+					  "getPlatform");
+
+  reply = dbus_connection_send_with_reply_and_block (connection,
+						     message, -1, error);
+  dbus_message_unref (message);
+
+  if (!reply)
+    return NULL;
+
+  dbus_message_iter_init (reply, &iter);
+  platform = utils_dup_string (&iter);
+
+  dbus_message_unref (reply);
+  return platform;
+}
+
+/* Blocking part of the session set up, it doesn't touch
+ * the session so it can be run in a separate thread */
+static void
+open_connections (OobsSessionConnectData *connect_data)
+{
+  DBusError error;
+
+  dbus_error_init (&connect_data->error);
+  connect_data->connection = dbus_bus_get (DBUS_BUS_SYSTEM, &connect_data->error);
+
+#ifdef HAVE_GDBUS
+  connect_data->gdbus_connection = open_gdbus_connection ();
+#endif
+
+  if (connect_data->connection && connect_data->detect_platform)
+    {
+      /* a platform the backends don't recognize isn't a connection error */
+      dbus_error_init (&error);
+      connect_data->platform = request_platform (connect_data->connection, &error);
+
+      if (dbus_error_is_set (&error))
+	dbus_error_free (&error);
+    }
+}
+
+static void
+finish_connect (OobsSessionConnectData *connect_data)
+{
+  OobsSession *session;
+  OobsSessionPrivate *priv;
+
+  session = connect_data->session;
+  priv = session->_priv;
+
+  priv->connection = connect_data->connection;
+#ifdef HAVE_GDBUS
+  priv->gdbus_connection = connect_data->gdbus_connection;
+#endif
+
+  /* GDBus dispatches replies and signals itself, libdbus
+   * is then only used for blocking calls */
+  if (dbus_error_is_set (&connect_data->error))
+    {
+      g_warning ("%s", connect_data->error.message);
+      dbus_error_free (&connect_data->error);
+    }
+  else if (!uses_gdbus (priv))
+    dbus_connection_setup_with_g_main (priv->connection, NULL);
+
+  priv->connecting = FALSE;
+
+  if (connect_data->platform)
+    {
+      g_free (priv->platform);
+      priv->platform = connect_data->platform;
+      g_object_notify (G_OBJECT (session), "platform");
+    }
+}
+
+static gboolean
+run_connect_callbacks (gpointer data)
+{
+  OobsSession *session;
+  OobsSessionPrivate *priv;
+  OobsSessionAsyncCallback *callback;
+  OobsResult result;
+  GSList *callbacks, *node;
+
+  session = OOBS_SESSION (data);
+  priv = session->_priv;
+
+  result = (priv->connection) ? OOBS_RESULT_OK : OOBS_RESULT_ERROR;
+  callbacks = g_slist_reverse (priv->connect_callbacks);
+  priv->connect_callbacks = NULL;
+
+  for (node = callbacks; node; node = node->next)
+    {
+      callback = node->data;
+      (* callback->func) (session, result, callback->data);
+      g_free (callback);
+    }
+
+  g_slist_free (callbacks);
+  return FALSE;
+}
+
+static gboolean
+connect_done_idle (gpointer data)
+{
+  OobsSessionConnectData *connect_data;
+  OobsSession *session;
+
+  connect_data = (OobsSessionConnectData*) data;
+  session = connect_data->session;
+
+  finish_connect (connect_data);
+  g_free (connect_data);
+
+  g_signal_emit (session, session_signals [CONNECTED], 0);
+  run_queued_requests (session);
+  run_connect_callbacks (session);
+
+  return FALSE;
+}
+
+static gpointer
+connect_thread (gpointer data)
+{
+  open_connections ((OobsSessionConnectData*) data);
+  g_idle_add (connect_done_idle, data);
+
+  return NULL;
+}
+
+static gboolean
+connect_idle (gpointer data)
+{
+  open_connections ((OobsSessionConnectData*) data);
+  return connect_done_idle (data);
+}
+
 static void
 oobs_session_init (OobsSession *session)
 {
   OobsSessionPrivate *priv;
+  gint i;
 
   g_return_if_fail (OOBS_IS_SESSION (session));
   priv = OOBS_SESSION_GET_PRIVATE (session);
 
+  /* the connection is set up by oobs_session_get()
+   * or oobs_session_get_async() */
   dbus_error_init (&priv->dbus_error);
-  priv->connection = dbus_bus_get (DBUS_BUS_SYSTEM, &priv->dbus_error);
 
-  if (dbus_error_is_set (&priv->dbus_error))
-    g_warning ("%s", priv->dbus_error.message);
-  else
-    dbus_connection_setup_with_g_main (priv->connection, NULL);
+  for (i = 0; i < N_PRIORITIES; i++)
+    priv->queued_requests[i] = g_queue_new ();
+
+  priv->running_requests = g_queue_new ();
+  priv->max_requests = DEFAULT_MAX_REQUESTS;
 
   priv->session_objects  = NULL;
-  priv->is_authenticated = FALSE;
+  priv->authorizations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  priv->authorization_timeout = DEFAULT_AUTHORIZATION_TIMEOUT;
   session->_priv = priv;
 }
 
@@ -185,14 +493,93 @@ oobs_session_get_property (GObject      *object,
 OobsSession*
 oobs_session_get (void)
 {
-  static OobsSession *session = NULL;
+  OobsSessionConnectData connect_data = { 0, };
+  OobsSession *session;
+  OobsSessionPrivate *priv;
 
-  if (!session)
-    session = g_object_new (OOBS_TYPE_SESSION, NULL);
+  session = g_object_new (OOBS_TYPE_SESSION, NULL);
+  priv = session->_priv;
+
+  /* a connection started by oobs_session_get_async() isn't
+   * waited for here, requests wait for it if needed */
+  if (!priv->connect_started)
+    {
+      priv->connect_started = TRUE;
+
+      connect_data.session = session;
+      open_connections (&connect_data);
+      finish_connect (&connect_data);
+    }
 
   return session;
 }
 
+/**
+ * oobs_session_get_async:
+ * @func: An #OobsSessionAsyncFunc.
+ * @data: User data to pass to @func.
+ *
+ * Asynchronous version of oobs_session_get(), the connection to the
+ * backends is set up and the platform detected without blocking the
+ * caller, @func is called from the main loop once it's done. Objects
+ * may be created in the meantime, their asynchronous requests are
+ * sent once the session is connected, and synchronous ones wait for it.
+ *
+ * If threads have been initialized with g_thread_init(), the blocking
+ * part of the set up runs in a separate thread, otherwise it runs from
+ * the main loop. libdbus is then made thread safe with
+ * dbus_threads_init_default(), which libdbus requires before any other
+ * use of it in the process. So in that case this function must be
+ * called before anything else, including other libraries, uses D-Bus,
+ * or the application must call dbus_threads_init_default() itself at
+ * startup.
+ **/
+void
+oobs_session_get_async (OobsSessionAsyncFunc func,
+			gpointer             data)
+{
+  OobsSessionConnectData *connect_data;
+  OobsSessionAsyncCallback *callback;
+  OobsSession *session;
+  OobsSessionPrivate *priv;
+
+  g_return_if_fail (func != NULL);
+
+  session = g_object_new (OOBS_TYPE_SESSION, NULL);
+  priv = session->_priv;
+
+  callback = g_new0 (OobsSessionAsyncCallback, 1);
+  callback->func = func;
+  callback->data = data;
+  priv->connect_callbacks = g_slist_prepend (priv->connect_callbacks, callback);
+
+  if (priv->connect_started)
+    {
+      if (!priv->connecting)
+	g_idle_add (run_connect_callbacks, session);
+
+      return;
+    }
+
+  priv->connect_started = TRUE;
+  priv->connecting = TRUE;
+
+  connect_data = g_new0 (OobsSessionConnectData, 1);
+  connect_data->session = session;
+  connect_data->detect_platform = TRUE;
+
+  if (g_thread_supported ())
+    {
+      /* see above, this must come before any other libdbus use */
+      dbus_threads_init_default ();
+
+      if (g_thread_create (connect_thread, connect_data, FALSE, NULL))
+	return;
+    }
+
+  g_idle_add (connect_idle, connect_data);
+}
+
 /**
  * oobs_session_commit:
  * @session: an #OobsSession
@@ -233,6 +620,7 @@ oobs_session_commit (OobsSession *session)
  * @session: An #OobsSession
  * 
  * Returns whether the connection with the backends is established.
+ * This is #FALSE while oobs_session_get_async() is still connecting.
  * 
  * Return Value: #TRUE if there's connection with the backends.
  **/
@@ -255,6 +643,8 @@ oobs_session_get_connected (OobsSession *session)
  * 
  * Retrieves the platform your system has been identified with, or
  * #NULL in case your platform is not recognized or other error happens.
+ * The platform is only requested to the backends once, and not at all
+ * if oobs_session_get_async() already detected it.
  * 
  * Return Value: An #OobsResult representing the error.
  **/
@@ -263,23 +653,17 @@ oobs_session_get_platform (OobsSession  *session,
 			   gchar       **platform)
 {
   OobsSessionPrivate *priv;
-  DBusMessage *message, *reply;
-  DBusMessageIter iter;
   OobsResult result;
 
   g_return_val_if_fail (OOBS_IS_SESSION (session), OOBS_RESULT_ERROR);
 
   priv = session->_priv;
+  _oobs_session_ensure_connected (session);
   g_return_val_if_fail (priv->connection != NULL, OOBS_RESULT_ERROR);
 
-  message = dbus_message_new_method_call (OOBS_DBUS_DESTINATION,
-					  PLATFORMS_PATH,
-					  PLATFORMS_INTERFACE,
-					  "getPlatform");
-
-  reply = dbus_connection_send_with_reply_and_block (priv->connection,
-						     message, -1, &priv->dbus_error);
-  dbus_message_unref (message);
+  /* already detected by oobs_session_get_async(), or set */
+  if (!priv->platform)
+    priv->platform = request_platform (priv->connection, &priv->dbus_error);
 
   if (dbus_error_is_set (&priv->dbus_error))
     {
@@ -300,13 +684,9 @@ oobs_session_get_platform (OobsSession  *session,
       return result;
     }
 
-  dbus_message_iter_init (reply, &iter);
-  priv->platform = utils_dup_string (&iter);
-
   if (platform)
     *platform = priv->platform;
 
-  dbus_message_unref (reply);
   return (priv->platform) ? OOBS_RESULT_OK : OOBS_RESULT_NO_PLATFORM;
 }
 
@@ -336,9 +716,11 @@ oobs_session_set_platform (OobsSession *session,
   g_return_val_if_fail (platform != NULL, OOBS_RESULT_ERROR);
 
   priv = session->_priv;
+  _oobs_session_ensure_connected (session);
   g_return_val_if_fail (priv->connection != NULL, OOBS_RESULT_ERROR);
   dbus_error_init (&error);
 
+  g_free (priv->platform);
   priv->platform = g_strdup (platform);
   g_object_notify (G_OBJECT (session), "platform");
 
@@ -379,6 +761,7 @@ get_supported_platforms (OobsSession *session, GList **list)
   GList *platforms = NULL;
 
   priv = session->_priv;
+  _oobs_session_ensure_connected (session);
   g_return_val_if_fail (priv->connection != NULL, OOBS_RESULT_ERROR);
 
   message = dbus_message_new_method_call (OOBS_DBUS_DESTINATION,
@@ -470,16 +853,85 @@ oobs_session_get_supported_platforms (OobsSession  *session,
  * @session: An #OobsSession
  * 
  * Blocks until all pending asynchronous requests have been processed.
+ * See oobs_session_wait() to wait with a timeout, and for the sources
+ * that may be dispatched meanwhile.
  **/
 void
 oobs_session_process_requests (OobsSession *session)
+{
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  oobs_session_wait (session, OOBS_SESSION_WAIT_ALL, -1);
+}
+
+static gboolean
+wait_timeout_cb (gpointer data)
+{
+  gboolean *timed_out = data;
+
+  *timed_out = TRUE;
+  return FALSE;
+}
+
+/**
+ * oobs_session_wait:
+ * @session: An #OobsSession
+ * @mode: An #OobsSessionWaitMode.
+ * @timeout: maximum time to wait in milliseconds, or -1 to wait
+ *           without limit.
+ *
+ * Blocks until all pending asynchronous requests in the session are
+ * done, or any of them is, depending on @mode. Replies are dispatched,
+ * and the callbacks called, as they arrive, so this may be used to
+ * bound the time spent waiting for the backends.
+ *
+ * This is done by iterating the default #GMainContext, since that is
+ * where the session connects and where replies are dispatched. Any
+ * other source attached to it, timeouts, idles and the application's
+ * own ones included, may be dispatched before this returns, so the
+ * application has to be prepared for reentrancy, the same as with a
+ * nested main loop. Use the asynchronous callbacks instead where that
+ * is not acceptable.
+ *
+ * Return Value: #TRUE if the requests waited for are done, or if there
+ *               were none, #FALSE if @timeout expired before.
+ **/
+gboolean
+oobs_session_wait (OobsSession         *session,
+		   OobsSessionWaitMode  mode,
+		   gint                 timeout)
 {
   OobsSessionPrivate *priv;
+  gboolean timed_out = FALSE;
+  gboolean done = FALSE;
+  guint n_done, timeout_id = 0;
 
-  g_return_if_fail (OOBS_IS_SESSION (session));
+  g_return_val_if_fail (OOBS_IS_SESSION (session), FALSE);
 
   priv = session->_priv;
-  g_list_foreach (priv->session_objects, (GFunc) oobs_object_process_requests, NULL);
+  n_done = priv->n_done_requests;
+
+  if (timeout >= 0)
+    timeout_id = g_timeout_add (timeout, wait_timeout_cb, &timed_out);
+
+  while (TRUE)
+    {
+      if (priv->n_queued_requests == 0 &&
+	  g_queue_is_empty (priv->running_requests))
+	done = TRUE;
+      else if (mode == OOBS_SESSION_WAIT_ANY && priv->n_done_requests != n_done)
+	done = TRUE;
+
+      if (done || timed_out)
+	break;
+
+      g_main_context_iteration (NULL, TRUE);
+    }
+
+  if (timeout_id && !timed_out)
+    g_source_remove (timeout_id);
+
+  return done;
 }
 
 /**
@@ -501,15 +953,661 @@ oobs_session_get_authentication_action (OobsSession *session)
   return POLKIT_ACTION;
 }
 
-/* protected methods */
-DBusConnection*
-_oobs_session_get_connection_bus (OobsSession *session)
+static gdouble
+get_current_time (void)
+{
+  GTimeVal now;
+
+  g_get_current_time (&now);
+  return now.tv_sec + (now.tv_usec / (gdouble) G_USEC_PER_SEC);
+}
+
+static gboolean
+can_run_request (OobsSessionPrivate  *priv,
+		 OobsRequestPriority  priority)
+{
+  guint n_running;
+
+  /* held back until the session is connected */
+  if (priv->connecting)
+    return FALSE;
+
+  if (priv->max_requests == 0)
+    return TRUE;
+
+  n_running = g_queue_get_length (priv->running_requests);
+
+  /* background requests leave a slot free for interactive ones */
+  if (priority == OOBS_REQUEST_PRIORITY_BACKGROUND && priv->max_requests > 1)
+    return (n_running < priv->max_requests - 1);
+
+  return (n_running < priv->max_requests);
+}
+
+static void
+run_request (OobsSession        *session,
+	     OobsSessionRequest *request)
 {
   OobsSessionPrivate *priv;
 
-  g_return_val_if_fail (session != NULL, NULL);
-  g_return_val_if_fail (OOBS_IS_SESSION (session), NULL);
+  priv = session->_priv;
+
+  priv->wait_time[request->priority] += get_current_time () - request->queued_time;
+  priv->n_waited[request->priority]++;
+
+  g_queue_push_tail_link (priv->running_requests, &request->link);
+  request->func (request, request->data);
+}
+
+/* Sends queued requests while there's room, by
+ * priority and then oldest first */
+static void
+run_queued_requests (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+  OobsSessionRequest *request;
+  GList *link;
+  gboolean changed = FALSE;
+  gint i;
 
   priv = session->_priv;
-  return priv->connection;
+
+  for (i = 0; i < N_PRIORITIES; i++)
+    {
+      while (!g_queue_is_empty (priv->queued_requests[i]) && can_run_request (priv, i))
+	{
+	  link = g_queue_pop_head_link (priv->queued_requests[i]);
+	  request = link->data;
+	  priv->n_queued_requests--;
+	  changed = TRUE;
+
+	  run_request (session, request);
+	}
+    }
+
+  if (changed)
+    g_signal_emit (session, session_signals [QUEUE_DEPTH_CHANGED], 0,
+		   priv->n_queued_requests);
+}
+
+static gchar *
+get_peer_address (OobsSession  *session,
+		  OobsResult   *result)
+{
+  OobsSessionPrivate *priv;
+  DBusMessage *message, *reply;
+  DBusMessageIter iter;
+  gchar *address;
+
+  priv = session->_priv;
+
+  message = dbus_message_new_method_call (OOBS_DBUS_DESTINATION,
+					  PEER_PATH,
+					  PEER_INTERFACE,
+					  "GetPeerAddress");
+
+  reply = dbus_connection_send_with_reply_and_block (priv->connection,
+						     message, -1, &priv->dbus_error);
+  dbus_message_unref (message);
+
+  if (dbus_error_is_set (&priv->dbus_error))
+    {
+      if (dbus_error_has_name (&priv->dbus_error, DBUS_ERROR_ACCESS_DENIED))
+	*result = OOBS_RESULT_ACCESS_DENIED;
+      else
+	{
+	  /* most likely, backends too old to support it */
+	  *result = OOBS_RESULT_ERROR;
+	  g_warning ("Could not get the backends peer address: %s", priv->dbus_error.message);
+	}
+
+      dbus_error_free (&priv->dbus_error);
+      return NULL;
+    }
+
+  dbus_message_iter_init (reply, &iter);
+  address = utils_dup_string (&iter);
+  dbus_message_unref (reply);
+
+  *result = (address) ? OOBS_RESULT_OK : OOBS_RESULT_MALFORMED_DATA;
+  return address;
+}
+
+static OobsResult
+open_peer_connection (OobsSession *session,
+		      const gchar *address)
+{
+  OobsSessionPrivate *priv;
+
+  priv = session->_priv;
+
+#ifdef HAVE_GDBUS
+  if (priv->gdbus_connection)
+    {
+      GError *error = NULL;
+
+      priv->gdbus_peer_connection =
+	g_dbus_connection_new_for_address_sync (address,
+						G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+						NULL, NULL, &error);
+      if (!priv->gdbus_peer_connection)
+	{
+	  g_warning ("Could not connect to the backends peer address: %s", error->message);
+	  g_error_free (error);
+	  return OOBS_RESULT_ERROR;
+	}
+
+      /* the bus connection stays usable if the backends go away */
+      g_dbus_connection_set_exit_on_close (priv->gdbus_peer_connection, FALSE);
+      return OOBS_RESULT_OK;
+    }
+#endif
+
+  priv->peer_connection = dbus_connection_open_private (address, &priv->dbus_error);
+
+  if (dbus_error_is_set (&priv->dbus_error))
+    {
+      g_warning ("Could not connect to the backends peer address: %s", priv->dbus_error.message);
+      dbus_error_free (&priv->dbus_error);
+      priv->peer_connection = NULL;
+      return OOBS_RESULT_ERROR;
+    }
+
+  dbus_connection_set_exit_on_disconnect (priv->peer_connection, FALSE);
+  dbus_connection_setup_with_g_main (priv->peer_connection, NULL);
+
+  return OOBS_RESULT_OK;
+}
+
+/**
+ * oobs_session_open_peer_connection:
+ * @session: An #OobsSession.
+ *
+ * Asks the backends for a private connection and sends all further
+ * requests from configuration objects through it, instead of going
+ * through the system bus daemon. This saves copies and context switches
+ * on large configurations. Change notifications are still received
+ * through the bus.
+ *
+ * If the backends don't support it, or the connection is closed later,
+ * requests keep going through the system bus.
+ *
+ * Return Value: An #OobsResult representing the error.
+ **/
+OobsResult
+oobs_session_open_peer_connection (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+  OobsResult result;
+  gchar *address;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), OOBS_RESULT_ERROR);
+
+  priv = session->_priv;
+  g_return_val_if_fail (priv->connection != NULL, OOBS_RESULT_ERROR);
+
+  /* already open, the getters drop connections that were closed */
+  if (_oobs_session_get_object_connection (session) != priv->connection)
+    return OOBS_RESULT_OK;
+
+#ifdef HAVE_GDBUS
+  if (priv->gdbus_connection &&
+      _oobs_session_get_gdbus_object_connection (session) != priv->gdbus_connection)
+    return OOBS_RESULT_OK;
+#endif
+
+  address = get_peer_address (session, &result);
+
+  if (!address)
+    return result;
+
+  result = open_peer_connection (session, address);
+  g_free (address);
+
+  return result;
+}
+
+/**
+ * oobs_session_set_bulk_transfer:
+ * @session: An #OobsSession.
+ * @bulk_transfer: whether to use bulk transfers.
+ *
+ * Sets whether large configurations are exchanged with the backends
+ * through file descriptors rather than inline in D-Bus messages. This
+ * avoids bus message size limits and extra copies, but requires
+ * backends implementing the getFd, setFd, addFd and delFd methods.
+ *
+ * Bulk transfers are only used on connections able to pass file
+ * descriptors, requests are sent inline otherwise.
+ **/
+void
+oobs_session_set_bulk_transfer (OobsSession *session,
+				gboolean     bulk_transfer)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+  priv->bulk_transfer = (bulk_transfer != FALSE);
+}
+
+/**
+ * oobs_session_set_max_requests:
+ * @session: An #OobsSession.
+ * @max_requests: maximum number of asynchronous requests in flight,
+ *                or 0 for no limit.
+ *
+ * Sets how many asynchronous requests may be waiting for a reply
+ * from the backends at once. Further requests are queued, and sent
+ * in order as replies arrive. See #OobsSession::queue-depth-changed.
+ **/
+void
+oobs_session_set_max_requests (OobsSession *session,
+			       guint        max_requests)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+  priv->max_requests = max_requests;
+
+  run_queued_requests (session);
+}
+
+/**
+ * oobs_session_get_max_requests:
+ * @session: An #OobsSession.
+ *
+ * Returns the maximum number of asynchronous requests in flight,
+ * see oobs_session_set_max_requests().
+ *
+ * Return Value: the maximum number of requests, 0 if there's no limit.
+ **/
+guint
+oobs_session_get_max_requests (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), 0);
+
+  priv = session->_priv;
+  return priv->max_requests;
+}
+
+/**
+ * oobs_session_get_queue_depth:
+ * @session: An #OobsSession.
+ *
+ * Returns the number of asynchronous requests waiting to be sent,
+ * because the maximum number of requests in flight was reached.
+ *
+ * Return Value: the number of queued requests.
+ **/
+guint
+oobs_session_get_queue_depth (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), 0);
+
+  priv = session->_priv;
+  return priv->n_queued_requests;
+}
+
+/**
+ * oobs_session_get_wait_time:
+ * @session: An #OobsSession.
+ * @priority: An #OobsRequestPriority.
+ *
+ * Returns the average time asynchronous requests of the given
+ * priority spent queued before being sent to the backends, see
+ * oobs_session_set_max_requests().
+ *
+ * Return Value: the average wait time in seconds, 0 if no
+ *               request of this priority was sent yet.
+ **/
+gdouble
+oobs_session_get_wait_time (OobsSession         *session,
+			    OobsRequestPriority  priority)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), 0);
+  g_return_val_if_fail (priority < N_PRIORITIES, 0);
+
+  priv = session->_priv;
+
+  if (priv->n_waited[priority] == 0)
+    return 0;
+
+  return priv->wait_time[priority] / priv->n_waited[priority];
+}
+
+/**
+ * oobs_session_set_authorization_timeout:
+ * @session: An #OobsSession.
+ * @timeout: time in seconds, or 0.
+ *
+ * Sets for how long a successful oobs_object_authenticate() is
+ * remembered, further authentications for the same action during
+ * that time don't contact the backends. 0 disables the cache, the
+ * default is 300 seconds.
+ **/
+void
+oobs_session_set_authorization_timeout (OobsSession *session,
+					guint        timeout)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+  priv->authorization_timeout = timeout;
+
+  if (timeout == 0)
+    g_hash_table_remove_all (priv->authorizations);
+}
+
+/**
+ * oobs_session_get_authorization_timeout:
+ * @session: An #OobsSession.
+ *
+ * Returns for how long authorizations are remembered, see
+ * oobs_session_set_authorization_timeout().
+ *
+ * Return Value: time in seconds, 0 if they are not cached.
+ **/
+guint
+oobs_session_get_authorization_timeout (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), 0);
+
+  priv = session->_priv;
+  return priv->authorization_timeout;
+}
+
+/* protected methods */
+gboolean
+_oobs_session_get_connecting (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), FALSE);
+
+  priv = session->_priv;
+  return priv->connecting;
+}
+
+/*
+ * Waits for a connection started by oobs_session_get_async()
+ * to be set up, returns whether the session is connected.
+ */
+gboolean
+_oobs_session_ensure_connected (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), FALSE);
+
+  priv = session->_priv;
+
+  /* the set up is finished from an idle in the default
+   * context, so other sources may be dispatched meanwhile */
+  while (priv->connecting)
+    g_main_context_iteration (NULL, TRUE);
+
+  return (priv->connection != NULL);
+}
+
+gboolean
+_oobs_session_is_authorized (OobsSession *session,
+			     const gchar *action)
+{
+  OobsSessionPrivate *priv;
+  gdouble *expiry;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), FALSE);
+
+  priv = session->_priv;
+  expiry = g_hash_table_lookup (priv->authorizations, action);
+
+  if (!expiry)
+    return FALSE;
+
+  if (get_current_time () < *expiry)
+    return TRUE;
+
+  g_hash_table_remove (priv->authorizations, action);
+  return FALSE;
+}
+
+/*
+ * Remembers a successful authentication for action, or
+ * forgets it if the backends cancelled or denied it.
+ */
+void
+_oobs_session_set_authorized (OobsSession *session,
+			      const gchar *action,
+			      gboolean     authorized)
+{
+  OobsSessionPrivate *priv;
+  gdouble *expiry;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+
+  if (!authorized)
+    {
+      g_hash_table_remove (priv->authorizations, action);
+      return;
+    }
+
+  if (priv->authorization_timeout == 0)
+    return;
+
+  expiry = g_new (gdouble, 1);
+  *expiry = get_current_time () + priv->authorization_timeout;
+  g_hash_table_replace (priv->authorizations, g_strdup (action), expiry);
+}
+
+gboolean
+_oobs_session_get_bulk_transfer (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), FALSE);
+
+  priv = session->_priv;
+  return priv->bulk_transfer;
+}
+
+DBusConnection*
+_oobs_session_get_connection_bus (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (session != NULL, NULL);
+  g_return_val_if_fail (OOBS_IS_SESSION (session), NULL);
+
+  priv = session->_priv;
+  return priv->connection;
+}
+
+#ifdef HAVE_GDBUS
+/*
+ * Returns the GDBus connection to use for objects
+ * traffic, or %NULL if libdbus is used instead.
+ */
+GDBusConnection*
+_oobs_session_get_gdbus_connection (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), NULL);
+
+  priv = session->_priv;
+  return priv->gdbus_connection;
+}
+#endif
+
+/*
+ * Returns the connection requests from configuration objects
+ * must be sent through, the bus one if there's no peer connection.
+ */
+DBusConnection*
+_oobs_session_get_object_connection (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), NULL);
+
+  priv = session->_priv;
+
+  if (priv->peer_connection &&
+      !dbus_connection_get_is_connected (priv->peer_connection))
+    {
+      g_warning ("Lost the peer connection to the backends, using the bus");
+
+      dbus_connection_unref (priv->peer_connection);
+      priv->peer_connection = NULL;
+    }
+
+  return (priv->peer_connection) ? priv->peer_connection : priv->connection;
+}
+
+#ifdef HAVE_GDBUS
+/*
+ * GDBus counterpart of _oobs_session_get_object_connection().
+ */
+GDBusConnection*
+_oobs_session_get_gdbus_object_connection (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_SESSION (session), NULL);
+
+  priv = session->_priv;
+
+  if (priv->gdbus_peer_connection &&
+      g_dbus_connection_is_closed (priv->gdbus_peer_connection))
+    {
+      g_warning ("Lost the peer connection to the backends, using the bus");
+
+      g_object_unref (priv->gdbus_peer_connection);
+      priv->gdbus_peer_connection = NULL;
+    }
+
+  return (priv->gdbus_peer_connection) ?
+    priv->gdbus_peer_connection : priv->gdbus_connection;
+}
+#endif
+
+/*
+ * Schedules an asynchronous request, func is called with data to
+ * send it, either right away or once there's room for it. func
+ * gets the request, which must be passed to
+ * _oobs_session_request_done() when the reply arrives.
+ */
+void
+_oobs_session_queue_request (OobsSession            *session,
+			     OobsRequestPriority     priority,
+			     OobsSessionRequestFunc  func,
+			     gpointer                data)
+{
+  OobsSessionPrivate *priv;
+  OobsSessionRequest *request;
+  gint i;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+
+  request = g_slice_new0 (OobsSessionRequest);
+  request->func = func;
+  request->data = data;
+  request->link.data = request;
+  request->priority = priority;
+  request->queued_time = get_current_time ();
+
+  /* requests of the same or higher priority queued before go first */
+  for (i = 0; i <= priority; i++)
+    if (!g_queue_is_empty (priv->queued_requests[i]))
+      break;
+
+  if (i > priority && can_run_request (priv, priority))
+    run_request (session, request);
+  else
+    {
+      g_queue_push_tail_link (priv->queued_requests[priority], &request->link);
+      priv->n_queued_requests++;
+
+      g_signal_emit (session, session_signals [QUEUE_DEPTH_CHANGED], 0,
+		     priv->n_queued_requests);
+    }
+}
+
+/*
+ * Sets the libdbus pending call of a request being sent,
+ * so _oobs_session_wait_request() can block on it.
+ */
+void
+_oobs_session_request_set_pending_call (OobsSessionRequest *request,
+					DBusPendingCall    *call)
+{
+  request->call = dbus_pending_call_ref (call);
+}
+
+void
+_oobs_session_request_done (OobsSession        *session,
+			    OobsSessionRequest *request)
+{
+  OobsSessionPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+  g_queue_unlink (priv->running_requests, &request->link);
+
+  if (request->call)
+    dbus_pending_call_unref (request->call);
+
+  g_slice_free (OobsSessionRequest, request);
+  priv->n_done_requests++;
+
+  run_queued_requests (session);
+}
+
+/*
+ * Blocks until the oldest request in flight is done.
+ */
+void
+_oobs_session_wait_request (OobsSession *session)
+{
+  OobsSessionPrivate *priv;
+  OobsSessionRequest *request;
+  DBusPendingCall *call;
+
+  g_return_if_fail (OOBS_IS_SESSION (session));
+
+  priv = session->_priv;
+  request = g_queue_peek_head (priv->running_requests);
+
+  if (request && request->call)
+    {
+      /* the request is freed when the notify function runs */
+      call = dbus_pending_call_ref (request->call);
+      dbus_pending_call_block (call);
+      dbus_pending_call_unref (call);
+    }
+  else
+    {
+      /* GDBus replies are dispatched in the default context,
+       * along with every other source attached to it */
+      g_main_context_iteration (NULL, TRUE);
+    }
 }
@@ -33,6 +33,33 @@ G_BEGIN_DECLS
 #define OOBS_IS_SESSION_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((o),    OOBS_TYPE_SESSION))
 #define OOBS_SESSION_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o),  OOBS_TYPE_SESSION, OobsSessionClass))
 
+/**
+ * OobsRequestPriority:
+ * @OOBS_REQUEST_PRIORITY_INTERACTIVE: Requests someone is waiting on, such as
+ *     committing a single user.
+ * @OOBS_REQUEST_PRIORITY_BACKGROUND: Bulk traffic, such as refreshing a whole
+ *     configuration in the background.
+ *
+ * Priority of the asynchronous requests of an #OobsObject, queued interactive
+ * requests are always sent before background ones. See oobs_object_update_async_full().
+ */
+typedef enum {
+  OOBS_REQUEST_PRIORITY_INTERACTIVE,
+  OOBS_REQUEST_PRIORITY_BACKGROUND
+} OobsRequestPriority;
+
+/**
+ * OobsSessionWaitMode:
+ * @OOBS_SESSION_WAIT_ALL: Wait until no asynchronous request is pending.
+ * @OOBS_SESSION_WAIT_ANY: Wait until any pending asynchronous request is done.
+ *
+ * What oobs_session_wait() waits for.
+ */
+typedef enum {
+  OOBS_SESSION_WAIT_ALL,
+  OOBS_SESSION_WAIT_ANY
+} OobsSessionWaitMode;
+
 typedef struct _OobsPlatform OobsPlatform;
 struct _OobsPlatform
 {
@@ -45,6 +72,10 @@ struct _OobsPlatform
 typedef struct _OobsSession      OobsSession;
 typedef struct _OobsSessionClass OobsSessionClass;
 
+typedef void (*OobsSessionAsyncFunc) (OobsSession *session,
+				      OobsResult   result,
+				      gpointer     data);
+
 struct _OobsSession
 {
   GObject parent;
@@ -64,6 +95,8 @@ struct _OobsSessionClass
 GType        oobs_session_get_type (void);
 
 OobsSession *oobs_session_get      (void);
+void         oobs_session_get_async (OobsSessionAsyncFunc  func,
+				     gpointer              data);
 OobsResult   oobs_session_commit   (OobsSession *session);
 
 gboolean     oobs_session_get_connected (OobsSession  *session);
@@ -75,6 +108,24 @@ OobsResult   oobs_session_set_platform            (OobsSession  *session,
 						   const gchar  *platform);
 
 void         oobs_session_process_requests  (OobsSession *session);
+gboolean     oobs_session_wait              (OobsSession         *session,
+					     OobsSessionWaitMode  mode,
+					     gint                 timeout);
+
+OobsResult   oobs_session_open_peer_connection (OobsSession *session);
+void         oobs_session_set_bulk_transfer    (OobsSession *session,
+						gboolean     bulk_transfer);
+
+void         oobs_session_set_max_requests     (OobsSession *session,
+						guint        max_requests);
+guint        oobs_session_get_max_requests     (OobsSession *session);
+guint        oobs_session_get_queue_depth      (OobsSession *session);
+gdouble      oobs_session_get_wait_time        (OobsSession         *session,
+						OobsRequestPriority  priority);
+
+void         oobs_session_set_authorization_timeout (OobsSession *session,
+						     guint        timeout);
+guint        oobs_session_get_authorization_timeout (OobsSession *session);
 
 G_CONST_RETURN gchar * oobs_session_get_authentication_action (OobsSession *session);
 
@@ -52,8 +52,12 @@ struct _OobsSMBConfigPrivate
   gchar *desc;
   gchar *wins_server;
 
+  /* login -> "", the users in the SMB password database */
   GHashTable *users;
 
+  /* login -> password, the passwords pending to be committed */
+  GHashTable *passwords;
+
   guint is_wins_server : 1;
 };
 
@@ -141,6 +145,9 @@ oobs_smb_config_init (OobsSMBConfig *config)
   priv->users = g_hash_table_new_full (g_str_hash, g_str_equal,
 				       (GDestroyNotify) g_free,
 				       (GDestroyNotify) g_free);
+  priv->passwords = g_hash_table_new_full (g_str_hash, g_str_equal,
+					   (GDestroyNotify) g_free,
+					   (GDestroyNotify) g_free);
   config->_priv = priv;
 }
 
@@ -210,6 +217,12 @@ oobs_smb_config_finalize (GObject *object)
   if (priv && priv->shares_list)
     g_object_unref (priv->shares_list);
 
+  if (priv)
+    {
+      g_hash_table_destroy (priv->users);
+      g_hash_table_destroy (priv->passwords);
+    }
+
   if (G_OBJECT_CLASS (oobs_smb_config_parent_class)->finalize)
     (* G_OBJECT_CLASS (oobs_smb_config_parent_class)->finalize) (object);
 }
@@ -293,6 +306,7 @@ oobs_smb_config_update (OobsObject *object)
   /* First of all, free the previous shares config */
   oobs_list_clear (priv->shares_list);
   g_hash_table_remove_all (priv->users);
+  g_hash_table_remove_all (priv->passwords);
 
   /* start recursing through the response array */
   dbus_message_iter_init    (reply, &iter);
@@ -369,10 +383,11 @@ append_smb_users (OobsObject      *object,
 {
   OobsSMBConfigPrivate *priv;
   DBusMessageIter array_iter, struct_iter;
-  GList *keys, *k;
+  GHashTableIter users_iter;
+  const gchar *login, *password;
 
   priv = OOBS_SMB_CONFIG (object)->_priv;
-  keys = g_hash_table_get_keys (priv->users);
+  g_hash_table_iter_init (&users_iter, priv->users);
 
   dbus_message_iter_open_container (iter,
 				    DBUS_TYPE_ARRAY,
@@ -382,19 +397,22 @@ append_smb_users (OobsObject      *object,
 				    DBUS_STRUCT_END_CHAR_AS_STRING,
 				    &array_iter);
 
-  for (k = keys; k; k = k->next)
+  /* Users missing from the array are removed from the password
+   * database, so all of them have to be sent, an empty password
+   * leaves the user's password unchanged */
+  while (g_hash_table_iter_next (&users_iter, (gpointer *) &login, NULL))
     {
+      password = g_hash_table_lookup (priv->passwords, login);
+
       dbus_message_iter_open_container (&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
 
-      utils_append_string (&struct_iter, k->data);
-      utils_append_string (&struct_iter, g_hash_table_lookup (priv->users, k->data));
+      utils_append_string (&struct_iter, login);
+      utils_append_string (&struct_iter, (password) ? password : "");
 
       dbus_message_iter_close_container (&array_iter, &struct_iter);
     }
 
   dbus_message_iter_close_container (iter, &array_iter);
-
-  g_list_free (keys);
 }
 
 static void
@@ -675,6 +693,7 @@ oobs_smb_config_delete_user_password (OobsSMBConfig *config,
   priv = OOBS_SMB_CONFIG_GET_PRIVATE (config);
 
   g_hash_table_remove (priv->users, oobs_user_get_login_name (user));
+  g_hash_table_remove (priv->passwords, oobs_user_get_login_name (user));
 }
 
 /**
@@ -699,6 +718,74 @@ oobs_smb_config_set_user_password (OobsSMBConfig *config,
   priv = OOBS_SMB_CONFIG_GET_PRIVATE (config);
 
   g_hash_table_insert (priv->users,
+		       g_strdup (oobs_user_get_login_name (user)),
+		       g_strdup (""));
+  g_hash_table_insert (priv->passwords,
 		       g_strdup (oobs_user_get_login_name (user)),
 		       g_strdup (password));
 }
+
+/**
+ * oobs_smb_config_apply_password_changes:
+ * @config: An #OobsSMBConfig
+ * @changes: array of #OobsSMBPasswordChange, each one containing a
+ *           login name and its new password, or %NULL to delete the
+ *           user from the SMB password database.
+ * @n_changes: number of elements in @changes.
+ *
+ * Sets or deletes the SMB passwords of several users and commits
+ * the result in a single request, this is equivalent to calling
+ * oobs_smb_config_set_user_password() or
+ * oobs_smb_config_delete_user_password() for each change and then
+ * oobs_object_commit(), but takes login names so there's no need to
+ * have an #OobsUser for each user.
+ *
+ * Once the commit succeeds, the passwords are no longer held by
+ * @config, so later commits only change the passwords set since then.
+ *
+ * Return Value: an #OobsResult enum with the error code.
+ **/
+OobsResult
+oobs_smb_config_apply_password_changes (OobsSMBConfig               *config,
+					const OobsSMBPasswordChange *changes,
+					guint                        n_changes)
+{
+  OobsSMBConfigPrivate *priv;
+  OobsResult result;
+  guint i;
+
+  g_return_val_if_fail (OOBS_IS_SMB_CONFIG (config), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (changes != NULL || n_changes == 0, OOBS_RESULT_MALFORMED_DATA);
+
+  /* don't leave the batch half applied */
+  for (i = 0; i < n_changes; i++)
+    g_return_val_if_fail (changes[i].login != NULL, OOBS_RESULT_MALFORMED_DATA);
+
+  priv = OOBS_SMB_CONFIG_GET_PRIVATE (config);
+
+  for (i = 0; i < n_changes; i++)
+    {
+      if (changes[i].password)
+	{
+	  g_hash_table_insert (priv->users,
+			       g_strdup (changes[i].login),
+			       g_strdup (""));
+	  g_hash_table_insert (priv->passwords,
+			       g_strdup (changes[i].login),
+			       g_strdup (changes[i].password));
+	}
+      else
+	{
+	  g_hash_table_remove (priv->users, changes[i].login);
+	  g_hash_table_remove (priv->passwords, changes[i].login);
+	}
+    }
+
+  result = oobs_object_commit (OOBS_OBJECT (config));
+
+  /* the passwords are already in the database, don't set them again */
+  if (result == OOBS_RESULT_OK)
+    g_hash_table_remove_all (priv->passwords);
+
+  return result;
+}
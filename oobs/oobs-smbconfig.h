@@ -38,6 +38,7 @@ G_BEGIN_DECLS
 
 typedef struct _OobsSMBConfig      OobsSMBConfig;
 typedef struct _OobsSMBConfigClass OobsSMBConfigClass;
+typedef struct _OobsSMBPasswordChange OobsSMBPasswordChange;
 
 struct _OobsSMBConfig
 {
@@ -57,6 +58,12 @@ struct _OobsSMBConfigClass
   void (*_oobs_padding4) (void);
 };
 
+struct _OobsSMBPasswordChange
+{
+  const gchar *login;
+  const gchar *password;
+};
+
 GType       oobs_smb_config_get_type     (void);
 
 OobsObject* oobs_smb_config_get          (void);
@@ -87,6 +94,10 @@ void                  oobs_smb_config_set_user_password    (OobsSMBConfig *confi
 							    OobsUser      *user,
 							    const gchar   *password);
 
+OobsResult            oobs_smb_config_apply_password_changes (OobsSMBConfig               *config,
+							      const OobsSMBPasswordChange *changes,
+							      guint                        n_changes);
+
 G_END_DECLS
 
 #endif /* __OOBS_SMB_CONFIG_H */
@@ -20,6 +20,7 @@
 
 #include <glib-object.h>
 #include "oobs-statichost.h"
+#include "oobs-statichost-private.h"
 
 /**
  * SECTION:oobs-statichost
@@ -54,6 +55,10 @@ enum {
   PROP_IP_ADDRESS,
 };
 
+/* Bumped whenever any static host changes, so
+ * OobsHostsConfig knows when to rebuild its indexes */
+static guint static_hosts_serial = 0;
+
 G_DEFINE_TYPE (OobsStaticHost, oobs_static_host, G_TYPE_OBJECT);
 
 static void
@@ -106,6 +111,7 @@ oobs_static_host_set_property (GObject      *object,
     case PROP_IP_ADDRESS:
       g_free (priv->ip_address);
       priv->ip_address = g_value_dup_string (value);
+      static_hosts_serial++;
       break;
     }
 }
@@ -261,4 +267,11 @@ oobs_static_host_set_aliases (OobsStaticHost *static_host, GList *aliases)
     }
 
   priv->aliases = aliases;
+  static_hosts_serial++;
+}
+
+guint
+_oobs_static_host_get_serial (void)
+{
+  return static_hosts_serial;
 }
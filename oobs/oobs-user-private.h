@@ -27,10 +27,47 @@ G_BEGIN_DECLS
 
 #include "oobs-user.h"
 
+/* Signature of the user struct sent by the backends */
+#define OOBS_USER_SIGNATURE "(ssuuassibis)"
+
 OobsUser *
 _oobs_user_create_from_dbus_reply (OobsUser        *user,
                                    DBusMessage     *reply,
-                                   DBusMessageIter  iter);
+                                   DBusMessageIter  iter,
+                                   OobsUserFields   fields);
+
+#ifdef HAVE_GDBUS
+#include <gio/gio.h>
+
+OobsUser *
+_oobs_user_create_from_variant    (OobsUser        *user,
+                                   GVariant        *variant,
+                                   OobsUserFields   fields);
+#endif
+
+OobsUserFields
+_oobs_user_get_loaded_fields      (OobsUser        *user);
+
+void
+_oobs_user_set_missing_fields     (OobsUser        *user,
+                                   OobsUserFields   fields);
+
+void
+_oobs_user_set_gid                (OobsUser        *user,
+                                   guint32          gid);
+
+guint
+_oobs_user_get_serial             (void);
+
+G_CONST_RETURN gchar *
+_oobs_user_get_password           (OobsUser        *user);
+
+gboolean
+_oobs_user_get_password_crypted   (OobsUser        *user);
+
+void
+_oobs_user_set_crypted_password   (OobsUser        *user,
+                                   const gchar     *crypted_password);
 
 G_END_DECLS
 
@@ -19,16 +19,17 @@
  *          Milan Bouchet-Valat <nalimilan@club.fr>.
  */
 
+#include "config.h"
 #include <glib-object.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <crypt.h>
-#include <utmpx.h>
 
 #include "oobs-object-private.h"
 #include "oobs-usersconfig.h"
+#include "oobs-usersconfig-private.h"
 #include "oobs-user.h"
 #include "oobs-user-private.h"
 #include "oobs-group.h"
@@ -70,9 +71,22 @@ struct _OobsUserPrivate {
   gboolean passwd_empty;
   gboolean passwd_disabled;
 
+  /* password flags as exchanged with the backends */
+  gint     passwd_flags;
+
   gboolean           encrypted_home;
   gchar             *locale;
   OobsUserHomeFlags  home_flags;
+
+  /* whether password is already hashed, see
+   * oobs_users_config_set_password_hashing() */
+  gboolean           password_crypted;
+
+  /* fields not retrieved on last update, see
+   * oobs_users_config_set_fields(), and the
+   * ones ensure_fields() is retrieving */
+  OobsUserFields     missing_fields;
+  OobsUserFields     fetching_fields;
 };
 
 static void oobs_user_class_init (OobsUserClass *class);
@@ -89,6 +103,8 @@ static void oobs_user_get_property (GObject      *object,
 				    GParamSpec   *pspec);
 
 static void oobs_user_commit             (OobsObject *object);
+static OobsResult oobs_user_prepare_commit (OobsObject *object,
+					    gboolean    blocking);
 static void oobs_user_update             (OobsObject *object);
 static void oobs_user_get_update_message (OobsObject *object);
 
@@ -113,6 +129,11 @@ enum
   PROP_ACTIVE
 };
 
+/* Bumped whenever the login or GECOS fields of any user
+ * change, so OobsUsersConfig knows when to rebuild its
+ * search index */
+static guint users_serial = 0;
+
 G_DEFINE_TYPE (OobsUser, oobs_user, OOBS_TYPE_OBJECT);
 
 static void
@@ -127,6 +148,12 @@ oobs_user_class_init (OobsUserClass *class)
 
   oobs_class->commit = oobs_user_commit;
   oobs_class->update = oobs_user_update;
+
+  _oobs_object_class_set_reply_signature (oobs_class, OOBS_USER_SIGNATURE);
+#ifdef HAVE_GDBUS
+  _oobs_object_class_set_variant_decoding (oobs_class);
+#endif
+  _oobs_object_class_set_prepare_commit_func (oobs_class, oobs_user_prepare_commit);
   oobs_class->get_update_message = oobs_user_get_update_message;
 
   g_object_class_install_property (object_class,
@@ -279,6 +306,87 @@ oobs_user_init (OobsUser *user)
   user->_priv         = priv;
 }
 
+/*
+ * Retrieves the fields left out by the last update if any of
+ * @fields is among them, see oobs_users_config_set_fields().
+ * Only those are decoded, so changes to the loaded fields
+ * that weren't committed yet are kept.
+ */
+static OobsResult
+ensure_fields (OobsUser       *user,
+	       OobsUserFields  fields)
+{
+  OobsUserPrivate *priv;
+  OobsResult result;
+
+  priv = user->_priv;
+
+  if (!(priv->missing_fields & fields))
+    return OOBS_RESULT_OK;
+
+  /* avoid recursing when the update sets the fields */
+  priv->fetching_fields = priv->missing_fields;
+  priv->missing_fields = 0;
+
+  result = oobs_object_update (OOBS_OBJECT (user));
+
+  if (result != OOBS_RESULT_OK)
+    priv->missing_fields = priv->fetching_fields;
+
+  priv->fetching_fields = 0;
+
+  return result;
+}
+
+/*
+ * The whole user is sent, so fields left out by the last update
+ * must be retrieved before committing, the loaded ones keep their
+ * values.
+ */
+static OobsResult
+oobs_user_prepare_commit (OobsObject *object,
+			  gboolean    blocking)
+{
+  OobsUserPrivate *priv;
+
+  priv = OOBS_USER (object)->_priv;
+
+  if (!priv->missing_fields)
+    return OOBS_RESULT_OK;
+
+  if (!blocking)
+    return OOBS_RESULT_MALFORMED_DATA;
+
+  return ensure_fields (OOBS_USER (object), OOBS_USER_FIELD_ALL);
+}
+
+static OobsUserFields
+get_property_field (guint prop_id)
+{
+  switch (prop_id)
+    {
+    case PROP_HOMEDIR:
+    case PROP_ENCRYPTED_HOME:
+    case PROP_HOME_FLAGS:
+      return OOBS_USER_FIELD_HOME;
+    case PROP_SHELL:
+      return OOBS_USER_FIELD_SHELL;
+    case PROP_FULL_NAME:
+    case PROP_ROOM_NO:
+    case PROP_WORK_PHONE_NO:
+    case PROP_HOME_PHONE_NO:
+    case PROP_OTHER_DATA:
+      return OOBS_USER_FIELD_GECOS;
+    case PROP_PASSWD_EMPTY:
+    case PROP_PASSWD_DISABLED:
+      return OOBS_USER_FIELD_PASSWORD_FLAGS;
+    case PROP_LOCALE:
+      return OOBS_USER_FIELD_LOCALE;
+    default:
+      return 0;
+    }
+}
+
 static void
 oobs_user_set_property (GObject      *object,
 			guint         prop_id,
@@ -293,15 +401,20 @@ oobs_user_set_property (GObject      *object,
   user = OOBS_USER (object);
   priv = user->_priv;
 
+  /* setting a field that wasn't retrieved would lose the others */
+  ensure_fields (user, get_property_field (prop_id));
+
   switch (prop_id)
     {
     case PROP_USERNAME:
       g_free (priv->username);
       priv->username = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_PASSWORD:
       g_free (priv->password);
       priv->password = g_value_dup_string (value);
+      priv->password_crypted = FALSE;
       break;
     case PROP_UID:
       priv->uid = g_value_get_uint (value);
@@ -317,22 +430,27 @@ oobs_user_set_property (GObject      *object,
     case PROP_FULL_NAME:
       g_free (priv->full_name);
       priv->full_name = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_ROOM_NO:
       g_free (priv->room_no);
       priv->room_no = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_WORK_PHONE_NO:
       g_free (priv->work_phone_no);
       priv->work_phone_no = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_HOME_PHONE_NO:
       g_free (priv->home_phone_no);
       priv->home_phone_no = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_OTHER_DATA:
       g_free (priv->other_data);
       priv->other_data = g_value_dup_string (value);
+      users_serial++;
       break;
     case PROP_PASSWD_EMPTY:
       priv->passwd_empty = g_value_get_boolean (value);
@@ -367,6 +485,9 @@ oobs_user_get_property (GObject      *object,
   user = OOBS_USER (object);
   priv = user->_priv;
 
+  /* missing fields are retrieved on first access */
+  ensure_fields (user, get_property_field (prop_id));
+
   switch (prop_id)
     {
     case PROP_USERNAME:
@@ -454,74 +575,174 @@ oobs_user_finalize (GObject *object)
     (* G_OBJECT_CLASS (oobs_user_parent_class)->finalize) (object);
 }
 
+/* Fields of the user struct exchanged with the backends, in order */
+static const UtilsField user_fields[] = {
+  { UTILS_FIELD_STRING,      "name",           G_STRUCT_OFFSET (OobsUserPrivate, username),      0, 0 },
+  { UTILS_FIELD_STRING,      NULL,             G_STRUCT_OFFSET (OobsUserPrivate, password),      0, UTILS_FIELD_SKIP_DECODE },
+  { UTILS_FIELD_UINT,        "uid",            G_STRUCT_OFFSET (OobsUserPrivate, uid),           0, 0 },
+  { UTILS_FIELD_UINT,        NULL,             G_STRUCT_OFFSET (OobsUserPrivate, gid),           0, 0 },
+  { UTILS_FIELD_ARRAY_BEGIN, NULL,             UTILS_FIELD_NO_OFFSET,                            OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "full-name",      G_STRUCT_OFFSET (OobsUserPrivate, full_name),     OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "room-number",    G_STRUCT_OFFSET (OobsUserPrivate, room_no),       OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "work-phone",     G_STRUCT_OFFSET (OobsUserPrivate, work_phone_no), OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "home-phone",     G_STRUCT_OFFSET (OobsUserPrivate, home_phone_no), OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "other-data",     G_STRUCT_OFFSET (OobsUserPrivate, other_data),    OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_ARRAY_END,   NULL,             UTILS_FIELD_NO_OFFSET,                            OOBS_USER_FIELD_GECOS, 0 },
+  { UTILS_FIELD_STRING,      "home-directory", G_STRUCT_OFFSET (OobsUserPrivate, homedir),       OOBS_USER_FIELD_HOME, 0 },
+  { UTILS_FIELD_STRING,      "shell",          G_STRUCT_OFFSET (OobsUserPrivate, shell),         OOBS_USER_FIELD_SHELL, 0 },
+  { UTILS_FIELD_INT,         NULL,             G_STRUCT_OFFSET (OobsUserPrivate, passwd_flags),  OOBS_USER_FIELD_PASSWORD_FLAGS, 0 },
+  { UTILS_FIELD_BOOLEAN,     "encrypted-home", G_STRUCT_OFFSET (OobsUserPrivate, encrypted_home), OOBS_USER_FIELD_HOME, 0 },
+  { UTILS_FIELD_INT,         "home-flags",     G_STRUCT_OFFSET (OobsUserPrivate, home_flags),    OOBS_USER_FIELD_HOME, 0 },
+  { UTILS_FIELD_STRING,      "locale",         G_STRUCT_OFFSET (OobsUserPrivate, locale),        OOBS_USER_FIELD_LOCALE, 0 },
+  /* TODO: use location and face when the backends support it */
+  { UTILS_FIELD_STRING,      NULL,             UTILS_FIELD_NO_OFFSET,                            0, UTILS_FIELD_ENCODE_ONLY },
+  { UTILS_FIELD_STRING,      NULL,             UTILS_FIELD_NO_OFFSET,                            0, UTILS_FIELD_ENCODE_ONLY }
+};
+
+/*
+ * Fields are decoded straight into the private struct. Properties
+ * are only notified on existing users, new ones have no listeners.
+ */
+static void
+begin_decode (OobsUser *user)
+{
+  OobsUserPrivate *priv;
+
+  priv = user->_priv;
+
+  /* nothing must be retrieved while the fields are being set */
+  priv->missing_fields = 0;
+  g_object_freeze_notify (G_OBJECT (user));
+}
+
+static OobsUser*
+end_decode (OobsUser       *user,
+	    OobsUserFields  fields,
+	    gboolean        notify)
+{
+  OobsUserPrivate *priv;
+
+  priv = user->_priv;
+
+  if (fields & OOBS_USER_FIELD_PASSWORD_FLAGS)
+    {
+      priv->passwd_empty = priv->passwd_flags & 1;
+      priv->passwd_disabled = ((priv->passwd_flags & (1 << 1)) != 0);
+
+      if (notify)
+	{
+	  g_object_notify (G_OBJECT (user), "password-empty");
+	  g_object_notify (G_OBJECT (user), "password-disabled");
+	}
+    }
+
+  /* login and GECOS fields were possibly replaced */
+  users_serial++;
+
+  /* ensure_fields() already cleared the fields it retrieves */
+  if (!(fields & UTILS_FIELD_MASK_ONLY))
+    priv->missing_fields = OOBS_USER_FIELD_ALL & ~fields;
+  g_object_thaw_notify (G_OBJECT (user));
+
+  return user;
+}
+
 OobsUser*
 _oobs_user_create_from_dbus_reply (OobsUser        *user,
                                    DBusMessage     *reply,
-                                   DBusMessageIter  struct_iter)
+                                   DBusMessageIter  struct_iter,
+                                   OobsUserFields   fields)
 {
-  OobsUserPrivate *priv;
-  DBusMessageIter iter, gecos_iter;
-  guint32 uid, gid;
-  const gchar *login, *passwd, *home, *shell;
-  const gchar *name, *room_number, *work_phone, *home_phone, *other_data;
-  const gchar *locale;
-  gint passwd_flags, home_flags;
-  gboolean enc_home, passwd_empty, passwd_disabled;
+  DBusMessageIter iter, login_iter;
+  gboolean notify;
 
   dbus_message_iter_recurse (&struct_iter, &iter);
 
-  login = utils_get_string (&iter);
-  passwd = utils_get_string (&iter);
-  uid = utils_get_uint (&iter);
-  gid = utils_get_uint (&iter);
+  notify = (user != NULL);
+
+  if (!user)
+    {
+      login_iter = iter;
+      user = oobs_user_new (utils_get_string (&login_iter));
 
-  /* GECOS fields */
-  dbus_message_iter_recurse (&iter, &gecos_iter);
+      if (!user)
+	return NULL;
+    }
 
-  name = utils_get_string (&gecos_iter);
-  room_number = utils_get_string (&gecos_iter);
-  work_phone = utils_get_string (&gecos_iter);
-  home_phone = utils_get_string (&gecos_iter);
-  other_data = utils_get_string (&gecos_iter);
-  /* end of GECOS fields */
+  begin_decode (user);
 
-  dbus_message_iter_next (&iter);
+  /* Fields that were not requested are skipped without being decoded */
+  utils_decode_fields (&iter, user_fields, G_N_ELEMENTS (user_fields), fields,
+		       user->_priv, (notify) ? G_OBJECT (user) : NULL);
 
-  home = utils_get_string (&iter);
-  shell = utils_get_string (&iter);
+  return end_decode (user, fields, notify);
+}
 
-  passwd_flags = utils_get_int (&iter);
-  passwd_empty = passwd_flags & 1;
-  passwd_disabled = ((passwd_flags & (1 << 1)) != 0);
+#ifdef HAVE_GDBUS
+/*
+ * GDBus counterpart of _oobs_user_create_from_dbus_reply(), decodes
+ * a (ssuuassibis) user struct straight from the reply body.
+ */
+OobsUser*
+_oobs_user_create_from_variant (OobsUser       *user,
+				GVariant       *variant,
+				OobsUserFields  fields)
+{
+  const gchar *login;
+  gboolean notify;
 
-  enc_home = utils_get_boolean (&iter);
-  home_flags = utils_get_int (&iter);
-  locale = utils_get_string (&iter);
+  notify = (user != NULL);
 
   if (!user)
-    user = oobs_user_new (login);
-
-  g_object_set (user,
-                "uid", uid,
-                "home-directory", home,
-                "shell", shell,
-                "full-name", name,
-                "room-number", room_number,
-                "work-phone", work_phone,
-                "home-phone", home_phone,
-                "other-data", other_data,
-                "encrypted-home", enc_home,
-                "home-flags", home_flags,
-                "password-empty", passwd_empty,
-                "password-disabled", passwd_disabled,
-                "locale", locale,
-                NULL);
-
-  /* GID is only kept internally */
+    {
+      g_variant_get_child (variant, 0, "&s", &login);
+      user = oobs_user_new (login);
+
+      if (!user)
+	return NULL;
+    }
+
+  begin_decode (user);
+
+  utils_decode_variant_fields (variant, user_fields, G_N_ELEMENTS (user_fields), fields,
+			       user->_priv, (notify) ? G_OBJECT (user) : NULL);
+
+  return end_decode (user, fields, notify);
+}
+#endif
+
+OobsUserFields
+_oobs_user_get_loaded_fields (OobsUser *user)
+{
+  OobsUserPrivate *priv;
+
   priv = user->_priv;
-  priv->gid = gid;
 
-  return user;
+  return OOBS_USER_FIELD_ALL & ~priv->missing_fields;
+}
+
+/*
+ * Marks fields of a user that wasn't built from a full reply as
+ * missing, they are retrieved before being read or committed.
+ */
+void
+_oobs_user_set_missing_fields (OobsUser       *user,
+			       OobsUserFields  fields)
+{
+  OobsUserPrivate *priv;
+
+  priv = user->_priv;
+  priv->missing_fields |= fields;
+}
+
+void
+_oobs_user_set_gid (OobsUser *user,
+		    guint32   gid)
+{
+  OobsUserPrivate *priv;
+
+  priv = user->_priv;
+  priv->gid = gid;
 }
 
 static gboolean
@@ -530,77 +751,16 @@ create_dbus_struct_from_user (OobsUser        *user,
 			      DBusMessageIter *iter)
 {
   OobsUserPrivate *priv;
-  guint32 uid;
-  gchar *login, *password, *shell, *homedir;
-  gchar *name, *room_number, *work_phone, *home_phone, *other_data;
-  gchar *locale;
-  gboolean enc_home;
-  gboolean passwd_empty, passwd_disabled;
-  gint passwd_flags, home_flags;
-  DBusMessageIter data_iter;
 
   priv = user->_priv;
 
-  g_object_get (user,
-		"name", &login,
-		"password", &password,
-		"uid", &uid,
-		"home-directory", &homedir,
-		"shell", &shell,
-		"full-name", &name,
-		"room-number", &room_number,
-		"work-phone", &work_phone,
-		"home-phone", &home_phone,
-		"other-data", &other_data,
-                "encrypted-home", &enc_home,
-                "home-flags", &home_flags,
-                "locale", &locale,
-                "password-empty", &passwd_empty,
-                "password-disabled", &passwd_disabled,
-		NULL);
-
   /* Login is the only required field,
    * since home dir, password and shell are allowed to be empty (see man 5 passwd) */
-  g_return_val_if_fail (login, FALSE);
-
-  passwd_flags = passwd_empty | (passwd_disabled << 1);
-
-  utils_append_string (iter, login);
-  utils_append_string (iter, password);
-  utils_append_uint (iter, uid);
-  utils_append_uint (iter, priv->gid);
+  g_return_val_if_fail (priv->username, FALSE);
 
-  dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &data_iter);
+  priv->passwd_flags = priv->passwd_empty | (priv->passwd_disabled << 1) | (priv->password_crypted << 2);
 
-  /* GECOS fields */
-  utils_append_string (&data_iter, name);
-  utils_append_string (&data_iter, room_number);
-  utils_append_string (&data_iter, work_phone);
-  utils_append_string (&data_iter, home_phone);
-  utils_append_string (&data_iter, other_data);
-
-  dbus_message_iter_close_container (iter, &data_iter);
-
-  utils_append_string (iter, homedir);
-  utils_append_string (iter, shell);
-  utils_append_int (iter, passwd_flags);
-  utils_append_boolean (iter, enc_home);
-  utils_append_int (iter, home_flags);
-  utils_append_string (iter, locale);
-  /* TODO: use location and face when the backends support it */
-  utils_append_string (iter, "");
-  utils_append_string (iter, "");
-
-  g_free (login);
-  g_free (password);
-  g_free (shell);
-  g_free (homedir);
-  g_free (name);
-  g_free (room_number);
-  g_free (work_phone);
-  g_free (home_phone);
-  g_free (other_data);
-  g_free (locale);
+  utils_encode_fields (iter, user_fields, G_N_ELEMENTS (user_fields), priv);
 
   return TRUE;
 }
@@ -611,18 +771,83 @@ oobs_user_commit (OobsObject *object)
   OobsUserPrivate *priv;
   DBusMessage *message;
   DBusMessageIter iter, struct_iter;
+  gchar *crypted_password;
 
+  priv = OOBS_USER_GET_PRIVATE (OOBS_USER (object));
   message = _oobs_object_get_dbus_message (object);
 
+  /* An empty password keeps the current one, anything else
+   * is hashed here if oobs_users_config_hash_passwords()
+   * didn't do it before and hashing is enabled */
+  if (priv->password && *priv->password && !priv->password_crypted)
+    {
+      crypted_password = _oobs_users_config_hash_password (OOBS_USERS_CONFIG (priv->config),
+							   priv->password);
+
+      if (crypted_password)
+	_oobs_user_set_crypted_password (OOBS_USER (object), crypted_password);
+
+      g_free (crypted_password);
+    }
+
   dbus_message_iter_init_append (message, &iter);
   dbus_message_iter_open_container (&iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
   create_dbus_struct_from_user (OOBS_USER (object), message, &struct_iter);
   dbus_message_iter_close_container (&iter, &struct_iter);
 
   /* Erase password field as soon as possible */
-  priv = OOBS_USER_GET_PRIVATE (OOBS_USER (object));
   if (priv->password)
     memset (priv->password, 0, strlen (priv->password));
+
+  priv->password_crypted = FALSE;
+}
+
+G_CONST_RETURN gchar *
+_oobs_user_get_password (OobsUser *user)
+{
+  OobsUserPrivate *priv;
+
+  priv = OOBS_USER_GET_PRIVATE (user);
+
+  return priv->password;
+}
+
+guint
+_oobs_user_get_serial (void)
+{
+  return users_serial;
+}
+
+gboolean
+_oobs_user_get_password_crypted (OobsUser *user)
+{
+  OobsUserPrivate *priv;
+
+  priv = OOBS_USER_GET_PRIVATE (user);
+
+  return priv->password_crypted;
+}
+
+/*
+ * Replaces the clear text password with its hash,
+ * which will be sent to the backends as is.
+ */
+void
+_oobs_user_set_crypted_password (OobsUser    *user,
+				 const gchar *crypted_password)
+{
+  OobsUserPrivate *priv;
+
+  priv = OOBS_USER_GET_PRIVATE (user);
+
+  if (priv->password)
+    {
+      memset (priv->password, 0, strlen (priv->password));
+      g_free (priv->password);
+    }
+
+  priv->password = g_strdup (crypted_password);
+  priv->password_crypted = TRUE;
 }
 
 /*
@@ -646,14 +871,39 @@ oobs_user_get_update_message (OobsObject *object)
 static void
 oobs_user_update (OobsObject *object)
 {
+  OobsUserPrivate *priv;
   DBusMessage *reply;
   DBusMessageIter iter;
+  guint fields;
+#ifdef HAVE_GDBUS
+  GVariant *body, *user_variant;
+#endif
 
-  reply = _oobs_object_get_dbus_message (object);
+  priv = OOBS_USER (object)->_priv;
+
+  if (priv->fetching_fields)
+    fields = priv->fetching_fields | UTILS_FIELD_MASK_ONLY;
+  else
+    fields = OOBS_USER_FIELD_ALL;
+
+#ifdef HAVE_GDBUS
+  body = _oobs_object_get_reply_variant (object);
+
+  if (body && g_variant_is_of_type (body, G_VARIANT_TYPE ("(" OOBS_USER_SIGNATURE ")")))
+    {
+      user_variant = g_variant_get_child_value (body, 0);
+      _oobs_user_create_from_variant (OOBS_USER (object), user_variant,
+				      (OobsUserFields) fields);
+      g_variant_unref (user_variant);
+      return;
+    }
+#endif
 
+  reply = _oobs_object_get_dbus_message (object);
   dbus_message_iter_init (reply, &iter);
 
-  _oobs_user_create_from_dbus_reply (OOBS_USER (object), reply, iter);
+  _oobs_user_create_from_dbus_reply (OOBS_USER (object), reply, iter,
+				     (OobsUserFields) fields);
 }
 
 /**
@@ -703,7 +953,9 @@ oobs_user_get_login_name (OobsUser *user)
  * @password: a new password for the user.
  * 
  * Sets a new password for the user. This password will be
- * interpreted as clean text and encrypted by the backends using PAM.
+ * interpreted as clean text and encrypted by the backends using PAM,
+ * unless hashing on the client side has been enabled through
+ * oobs_users_config_set_password_hashing().
  * Be careful deleting the passed string after using this function.
  **/
 void
@@ -814,6 +1066,7 @@ oobs_user_get_home_directory (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_HOME);
 
   return priv->homedir;
 }
@@ -853,6 +1106,7 @@ oobs_user_get_shell (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_SHELL);
 
   return priv->shell;
 }
@@ -891,6 +1145,7 @@ oobs_user_get_full_name (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   return priv->full_name;
 }
@@ -914,6 +1169,7 @@ oobs_user_get_full_name_fallback (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   if (priv->full_name && *priv->full_name != '\0')
     return priv->full_name;
@@ -955,6 +1211,7 @@ oobs_user_get_room_number (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   return priv->room_no;
 }
@@ -993,6 +1250,7 @@ oobs_user_get_work_phone_number (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   return priv->work_phone_no;
 }
@@ -1031,6 +1289,7 @@ oobs_user_get_home_phone_number (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   return priv->home_phone_no;
 }
@@ -1069,6 +1328,7 @@ oobs_user_get_other_data (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_GECOS);
 
   return priv->other_data;
 }
@@ -1106,6 +1366,7 @@ oobs_user_get_password_empty (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_PASSWORD_FLAGS);
 
   return priv->passwd_empty;
 }
@@ -1127,6 +1388,7 @@ oobs_user_set_password_empty (OobsUser *user, gboolean empty)
   g_return_if_fail (OOBS_IS_USER (user));
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_PASSWORD_FLAGS);
 
   priv->passwd_empty = empty;
 }
@@ -1149,6 +1411,7 @@ oobs_user_get_password_disabled (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_PASSWORD_FLAGS);
 
   return priv->passwd_disabled;
 }
@@ -1190,6 +1453,7 @@ oobs_user_get_encrypted_home (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_HOME);
 
   return priv->encrypted_home;
 }
@@ -1212,6 +1476,7 @@ oobs_user_set_encrypted_home (OobsUser *user, gboolean encrypted_home)
   g_return_if_fail (OOBS_IS_USER (user));
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_HOME);
 
   priv->encrypted_home = encrypted_home;
 }
@@ -1249,6 +1514,7 @@ oobs_user_get_locale (OobsUser *user)
   g_return_val_if_fail (OOBS_IS_USER (user), NULL);
 
   priv = user->_priv;
+  ensure_fields (user, OOBS_USER_FIELD_LOCALE);
 
   return priv->locale;
 }
@@ -1274,32 +1540,25 @@ oobs_user_set_locale (OobsUser *user, const gchar *locale)
  * @user: An #OobsUser
  *
  * Returns whether the use is currently logged in the system.
+ * The sessions database is only read again when it changes, the
+ * #OobsUsersConfig::user-active-changed signal and the "active"
+ * property notifications tell when this value changes.
  *
  * Return Value: #TRUE if the user is logged in the system.
  **/
 gboolean
 oobs_user_get_active (OobsUser *user)
 {
-  struct utmpx *entry;
+  OobsObject *users_config;
   const gchar *login;
-  gboolean match = FALSE;
 
   g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
 
   login = oobs_user_get_login_name (user);
+  users_config = oobs_users_config_get ();
 
-  setutxent ();
-
-  while (!match && (entry = getutxent ()) != NULL)
-     {
-       match = (entry->ut_type == USER_PROCESS &&
-               strcmp (entry->ut_user, login) == 0);
-     }
-
-  /* close utmp */
-  endutxent ();
-
-  return match;
+  /* sessions are cached and monitored by the users config */
+  return (_oobs_users_config_get_n_sessions (OOBS_USERS_CONFIG (users_config), login) > 0);
 }
 
 /**
@@ -1337,22 +1596,8 @@ oobs_user_is_root (OobsUser *user)
 gboolean
 oobs_user_is_in_group (OobsUser *user, OobsGroup *group)
 {
-  OobsUser *tmp_user;
-  GList *users = NULL;
-  GList *l;
-
   g_return_val_if_fail (OOBS_IS_USER (user), FALSE);
   g_return_val_if_fail (OOBS_IS_GROUP (group), FALSE);
 
-  users = oobs_group_get_users (group);
-
-  for (l = users; l; l = l->next) {
-    tmp_user = l->data;
-    if (tmp_user == user)
-      break;
-  }
-
-  g_list_free (users);
-
-  return l != NULL;
+  return oobs_group_contains_user (group, user);
 }
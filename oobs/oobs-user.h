@@ -77,6 +77,27 @@ typedef enum {
   OOBS_USER_ERASE_HOME   = 1 << 3
 } OobsUserHomeFlags;
 
+/**
+ * OobsUserFields:
+ * @OOBS_USER_FIELD_GECOS: Full name and the other GECOS fields.
+ * @OOBS_USER_FIELD_HOME: Home directory, home flags and whether it is encrypted.
+ * @OOBS_USER_FIELD_SHELL: Default shell.
+ * @OOBS_USER_FIELD_PASSWORD_FLAGS: Whether the password is empty or disabled.
+ * @OOBS_USER_FIELD_LOCALE: Locale.
+ * @OOBS_USER_FIELD_ALL: All of the above.
+ *
+ * Optional fields of an #OobsUser, the login name, UID and main group are
+ * always retrieved. See oobs_users_config_set_fields().
+ */
+typedef enum {
+  OOBS_USER_FIELD_GECOS          = 1,
+  OOBS_USER_FIELD_HOME           = 1 << 1,
+  OOBS_USER_FIELD_SHELL          = 1 << 2,
+  OOBS_USER_FIELD_PASSWORD_FLAGS = 1 << 3,
+  OOBS_USER_FIELD_LOCALE         = 1 << 4,
+  OOBS_USER_FIELD_ALL            = (1 << 5) - 1
+} OobsUserFields;
+
 GType oobs_user_get_type (void);
 
 OobsUser* oobs_user_new (const gchar *name);
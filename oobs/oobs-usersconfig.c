@@ -19,20 +19,28 @@
  *          Milan Bouchet-Valat <nalimilan@club.fr>.
  */
 
+#include "config.h"
 #include <dbus/dbus.h>
 #include <glib-object.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <utmpx.h>
+#include <crypt.h>
 
 #include "oobs-object.h"
 #include "oobs-object-private.h"
 #include "oobs-list.h"
 #include "oobs-list-private.h"
 #include "oobs-usersconfig.h"
+#include "oobs-usersconfig-private.h"
 #include "oobs-user.h"
 #include "oobs-user-private.h"
 #include "oobs-defines.h"
 #include "oobs-groupsconfig.h"
 #include "oobs-group.h"
+#include "oobs-group-private.h"
+#include "utmp-monitor.h"
 #include "utils.h"
 
 /**
@@ -43,6 +51,8 @@
  **/
 
 #define USERS_CONFIG_REMOTE_OBJECT "UsersConfig2"
+#define SEARCH_KEY_SEPARATOR '\n'
+#define USERS_REPLY_SIGNATURE "a" OOBS_USER_SIGNATURE "asuussub"
 #define OOBS_USERS_CONFIG_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), OOBS_TYPE_USERS_CONFIG, OobsUsersConfigPrivate))
 
 typedef struct _OobsUsersConfigPrivate OobsUsersConfigPrivate;
@@ -64,8 +74,50 @@ struct _OobsUsersConfigPrivate
   gboolean  encrypted_home;
 
   OobsGroup *default_group;
+
+  /* login -> number of sessions, parsed from utmp */
+  GHashTable *sessions;
+  time_t      utmp_mtime;
+  off_t       utmp_size;
+
+  guint sessions_loaded    : 1;
+  guint monitor_started    : 1;
+  guint sessions_monitored : 1;
+
+  /* client side password hashing */
+  OobsPasswordScheme password_scheme;
+  guint              password_rounds;
+
+  /* search index: users (not referenced) and their casefolded
+   * login and GECOS fields, plus a map from every bigram and
+   * trigram to the sorted array of indexes of users containing it */
+  GPtrArray  *search_users;
+  GPtrArray  *search_keys;
+  GHashTable *search_ngrams;
+
+  /* _oobs_list_get_serial() and _oobs_user_get_serial()
+   * values when the search index was last known to be valid */
+  guint search_list_serial;
+  guint search_users_serial;
+  guint search_valid : 1;
+
+  /* see oobs_users_config_set_filter() */
+  OobsUsersFilterFlags  filter_flags;
+  uid_t                 filter_uid_min;
+  uid_t                 filter_uid_max;
+  gchar                *filter_login;
+  GPatternSpec         *filter_pattern;
+
+  /* see oobs_users_config_set_fields() */
+  OobsUserFields        fields;
 };
 
+typedef struct {
+  gchar *password;
+  gchar *setting;
+  gchar *result;
+} HashJob;
+
 static void oobs_users_config_class_init  (OobsUsersConfigClass *class);
 static void oobs_users_config_init        (OobsUsersConfig      *config);
 static void oobs_users_config_constructed (GObject              *object);
@@ -85,6 +137,13 @@ static void oobs_users_config_groups_updated (OobsUsersConfig  *users,
 
 static void oobs_users_config_update     (OobsObject   *object);
 static void oobs_users_config_commit     (OobsObject   *object);
+static void oobs_users_config_get_update_message (OobsObject *object);
+
+enum
+{
+  USER_ACTIVE_CHANGED,
+  LAST_SIGNAL
+};
 
 enum
 {
@@ -97,6 +156,8 @@ enum
   PROP_ENCRYPTED_HOME,
 };
 
+static guint users_config_signals [LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (OobsUsersConfig, oobs_users_config, OOBS_TYPE_OBJECT);
 
 
@@ -113,6 +174,12 @@ oobs_users_config_class_init (OobsUsersConfigClass *class)
 
   oobs_object_class->commit  = oobs_users_config_commit;
   oobs_object_class->update  = oobs_users_config_update;
+  oobs_object_class->get_update_message = oobs_users_config_get_update_message;
+
+  _oobs_object_class_set_reply_signature (oobs_object_class, USERS_REPLY_SIGNATURE);
+#ifdef HAVE_GDBUS
+  _oobs_object_class_set_variant_decoding (oobs_object_class);
+#endif
 
   g_object_class_install_property (object_class,
 				   PROP_MINIMUM_UID,
@@ -157,10 +224,33 @@ oobs_users_config_class_init (OobsUsersConfigClass *class)
 				                         FALSE,
 				                         G_PARAM_READABLE));
 
+  /**
+   * OobsUsersConfig::user-active-changed:
+   * @config: the object which received the signal.
+   * @user: the #OobsUser that logged in or out.
+   *
+   * Emitted when a user opens its first session or closes its last
+   * one, see oobs_user_get_active(). Changes are only tracked once
+   * oobs_user_get_active() has been called for any user.
+   **/
+  users_config_signals [USER_ACTIVE_CHANGED] =
+    g_signal_new ("user-active-changed",
+		  G_OBJECT_CLASS_TYPE (object_class),
+		  G_SIGNAL_RUN_LAST,
+		  0, NULL, NULL,
+		  g_cclosure_marshal_VOID__OBJECT,
+		  G_TYPE_NONE, 1, OOBS_TYPE_USER);
+
   g_type_class_add_private (object_class,
 			    sizeof (OobsUsersConfigPrivate));
 }
 
+static void
+free_postings (GArray *postings)
+{
+  g_array_free (postings, TRUE);
+}
+
 static void
 oobs_users_config_init (OobsUsersConfig *config)
 {
@@ -173,6 +263,167 @@ oobs_users_config_init (OobsUsersConfig *config)
   config->_priv = priv;
 
   priv->groups = g_hash_table_new (NULL, NULL);
+  priv->sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
+					  (GDestroyNotify) g_free, NULL);
+
+  priv->fields = OOBS_USER_FIELD_ALL;
+
+  priv->search_users = g_ptr_array_new ();
+  priv->search_keys = g_ptr_array_new ();
+  priv->search_ngrams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					       NULL, (GDestroyNotify) free_postings);
+}
+
+static gchar *
+get_search_key (OobsUser *user)
+{
+  const gchar *fields[6];
+  GString *str;
+  gchar *key;
+  guint i;
+
+  memset (fields, 0, sizeof (fields));
+  fields[0] = oobs_user_get_login_name (user);
+
+  /* don't retrieve GECOS fields left out by the last update */
+  if (_oobs_user_get_loaded_fields (user) & OOBS_USER_FIELD_GECOS)
+    {
+      fields[1] = oobs_user_get_full_name (user);
+      fields[2] = oobs_user_get_room_number (user);
+      fields[3] = oobs_user_get_work_phone_number (user);
+      fields[4] = oobs_user_get_home_phone_number (user);
+      fields[5] = oobs_user_get_other_data (user);
+    }
+
+  str = g_string_new (NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (fields); i++)
+    {
+      if (!fields[i] || !*fields[i])
+	continue;
+
+      g_string_append (str, fields[i]);
+      g_string_append_c (str, SEARCH_KEY_SEPARATOR);
+    }
+
+  key = g_utf8_casefold (str->str, str->len);
+  g_string_free (str, TRUE);
+
+  return key;
+}
+
+/* n-grams are made of bytes, so multibyte characters don't need special care */
+static guint32
+get_ngram (const gchar *str,
+	   guint        len)
+{
+  const guchar *s = (const guchar *) str;
+
+  if (len == 2)
+    return (2 << 24) | (s[0] << 8) | s[1];
+  else
+    return (3 << 24) | (s[0] << 16) | (s[1] << 8) | s[2];
+}
+
+static void
+add_ngram (OobsUsersConfigPrivate *priv,
+	   guint32                 ngram,
+	   guint                   index)
+{
+  GArray *postings;
+
+  postings = g_hash_table_lookup (priv->search_ngrams, GUINT_TO_POINTER (ngram));
+
+  if (!postings)
+    {
+      postings = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_hash_table_insert (priv->search_ngrams, GUINT_TO_POINTER (ngram), postings);
+    }
+  else if (g_array_index (postings, guint, postings->len - 1) == index)
+    return;
+
+  g_array_append_val (postings, index);
+}
+
+static void
+index_user (OobsUsersConfigPrivate *priv,
+	    OobsUser               *user)
+{
+  gchar *key;
+  guint index, len, i;
+
+  key = get_search_key (user);
+  index = priv->search_users->len;
+  len = strlen (key);
+
+  g_ptr_array_add (priv->search_users, user);
+  g_ptr_array_add (priv->search_keys, key);
+
+  for (i = 0; i + 1 < len; i++)
+    {
+      if (key[i] == SEARCH_KEY_SEPARATOR || key[i + 1] == SEARCH_KEY_SEPARATOR)
+	continue;
+
+      add_ngram (priv, get_ngram (&key[i], 2), index);
+
+      if (i + 2 < len && key[i + 2] != SEARCH_KEY_SEPARATOR)
+	add_ngram (priv, get_ngram (&key[i], 3), index);
+    }
+}
+
+static void
+stamp_search_index (OobsUsersConfigPrivate *priv)
+{
+  priv->search_list_serial = _oobs_list_get_serial (priv->users_list);
+  priv->search_users_serial = _oobs_user_get_serial ();
+  priv->search_valid = TRUE;
+}
+
+static void
+clear_search_index (OobsUsersConfigPrivate *priv)
+{
+  g_ptr_array_foreach (priv->search_keys, (GFunc) g_free, NULL);
+  g_ptr_array_set_size (priv->search_keys, 0);
+  g_ptr_array_set_size (priv->search_users, 0);
+  g_hash_table_remove_all (priv->search_ngrams);
+  priv->search_valid = FALSE;
+}
+
+static void
+build_search_index (OobsUsersConfigPrivate *priv)
+{
+  OobsListIter iter;
+  GObject *user;
+  gboolean valid;
+
+  clear_search_index (priv);
+  valid = oobs_list_get_iter_first (priv->users_list, &iter);
+
+  while (valid)
+    {
+      user = oobs_list_get (priv->users_list, &iter);
+      index_user (priv, OOBS_USER (user));
+      g_object_unref (user);
+
+      valid = oobs_list_iter_next (priv->users_list, &iter);
+    }
+
+  stamp_search_index (priv);
+}
+
+/*
+ * Rebuilds the search index if the users list has been
+ * modified or users have been renamed since it was built.
+ */
+static void
+ensure_search_index (OobsUsersConfigPrivate *priv)
+{
+  if (priv->search_valid &&
+      priv->search_list_serial == _oobs_list_get_serial (priv->users_list) &&
+      priv->search_users_serial == _oobs_user_get_serial ())
+    return;
+
+  build_search_index (priv);
 }
 
 static void
@@ -182,6 +433,7 @@ free_configuration (OobsUsersConfig *config)
 
   priv = config->_priv;
 
+  clear_search_index (priv);
   oobs_list_clear (priv->users_list);
   g_free (priv->default_shell);
   g_free (priv->default_home);
@@ -217,6 +469,14 @@ oobs_users_config_finalize (GObject *object)
     {
       free_configuration (OOBS_USERS_CONFIG (object));
       g_hash_table_unref (priv->groups);
+      g_hash_table_destroy (priv->sessions);
+      g_ptr_array_free (priv->search_users, TRUE);
+      g_ptr_array_free (priv->search_keys, TRUE);
+      g_hash_table_destroy (priv->search_ngrams);
+      g_free (priv->filter_login);
+
+      if (priv->filter_pattern)
+	g_pattern_spec_free (priv->filter_pattern);
 
       if (priv->users_list)
 	g_object_unref (priv->users_list);
@@ -307,33 +567,92 @@ oobs_users_config_groups_updated (OobsUsersConfig  *users,
     }
 }
 
+/*
+ * Checks a user against the filter before creating it,
+ * in case the backends returned more users than requested.
+ */
+static gboolean
+user_matches_filter (OobsUsersConfigPrivate *priv,
+		     const gchar            *login,
+		     uid_t                   uid,
+		     uid_t                   minimum_uid,
+		     uid_t                   maximum_uid)
+{
+  if ((priv->filter_flags & OOBS_USERS_FILTER_UID_RANGE) &&
+      (uid < priv->filter_uid_min || uid > priv->filter_uid_max))
+    return FALSE;
+
+  if ((priv->filter_flags & OOBS_USERS_FILTER_NON_SYSTEM) &&
+      (uid < minimum_uid || uid > maximum_uid))
+    return FALSE;
+
+  if ((priv->filter_flags & OOBS_USERS_FILTER_LOGIN) &&
+      (!login || !g_pattern_match_string (priv->filter_pattern, login)))
+    return FALSE;
+
+  return TRUE;
+}
+
 static void
-oobs_users_config_update (OobsObject *object)
+append_user (OobsUsersConfigPrivate *priv,
+	     OobsUser               *user)
 {
-  OobsUsersConfigPrivate *priv;
-  OobsObject      *groups_config;
-  DBusMessage     *reply;
-  DBusMessageIter  iter, elem_iter;
-  OobsListIter     list_iter;
-  GObject         *user;
+  OobsListIter list_iter;
 
-  priv  = OOBS_USERS_CONFIG (object)->_priv;
-  reply = _oobs_object_get_dbus_message (object);
+  if (!user)
+    return;
 
-  /* First of all, free the previous configuration */
-  free_configuration (OOBS_USERS_CONFIG (object));
+  oobs_list_append (priv->users_list, &list_iter);
+  oobs_list_set    (priv->users_list, &list_iter, G_OBJECT (user));
+
+  g_object_unref (user);
+}
+
+static void
+update_from_message (OobsUsersConfigPrivate *priv,
+		     DBusMessage            *reply)
+{
+  DBusMessageIter  iter, elem_iter;
+  DBusMessageIter  tail_iter, user_iter;
+  const gchar     *login;
+  uid_t            uid, minimum_uid = 0, maximum_uid = 0;
+
+  /* a GDBus reply may fail to be converted */
+  if (!reply)
+    return;
 
   dbus_message_iter_init (reply, &iter);
+
+  if (priv->filter_flags & OOBS_USERS_FILTER_NON_SYSTEM)
+    {
+      /* UID limits come after the users and shells arrays */
+      tail_iter = iter;
+      dbus_message_iter_next (&tail_iter);
+      dbus_message_iter_next (&tail_iter);
+      minimum_uid = utils_get_uint (&tail_iter);
+      maximum_uid = utils_get_uint (&tail_iter);
+    }
+
   dbus_message_iter_recurse (&iter, &elem_iter);
 
   while (dbus_message_iter_get_arg_type (&elem_iter) == DBUS_TYPE_STRUCT)
     {
-      user = G_OBJECT (_oobs_user_create_from_dbus_reply (NULL, reply, elem_iter));
+      if (priv->filter_flags != OOBS_USERS_FILTER_NONE)
+	{
+	  dbus_message_iter_recurse (&elem_iter, &user_iter);
 
-      oobs_list_append (priv->users_list, &list_iter);
-      oobs_list_set    (priv->users_list, &list_iter, G_OBJECT (user));
+	  login = utils_get_string (&user_iter);
+	  dbus_message_iter_next (&user_iter); /* password */
+	  uid = utils_get_uint (&user_iter);
 
-      g_object_unref (user);
+	  if (!user_matches_filter (priv, login, uid, minimum_uid, maximum_uid))
+	    {
+	      dbus_message_iter_next (&elem_iter);
+	      continue;
+	    }
+	}
+
+      append_user (priv, _oobs_user_create_from_dbus_reply (NULL, reply, elem_iter, priv->fields));
 
       dbus_message_iter_next (&elem_iter);
     }
@@ -348,6 +667,93 @@ oobs_users_config_update (OobsObject *object)
   priv->default_shell = g_strdup (utils_get_string (&iter));
   priv->default_gid = utils_get_uint (&iter);
   priv->encrypted_home = utils_get_boolean (&iter);
+}
+
+#ifdef HAVE_GDBUS
+#define USERS_REPLY_TYPE "(" USERS_REPLY_SIGNATURE ")"
+
+/*
+ * Same as update_from_message(), for replies received through
+ * GDBus: users are decoded from the body without converting it.
+ */
+static void
+update_from_variant (OobsUsersConfigPrivate *priv,
+		     GVariant               *body)
+{
+  GVariant     *users, *user_variant;
+  GVariantIter  users_iter, *shells_iter;
+  const gchar  *login, *home, *shell;
+  guint32       uid, minimum_uid, maximum_uid, gid;
+  gboolean      encrypted_home;
+  gchar        *str;
+
+  g_variant_get (body, "(@a" OOBS_USER_SIGNATURE "asuu&s&sub)",
+		 &users, &shells_iter, &minimum_uid, &maximum_uid,
+		 &home, &shell, &gid, &encrypted_home);
+
+  g_variant_iter_init (&users_iter, users);
+
+  while ((user_variant = g_variant_iter_next_value (&users_iter)) != NULL)
+    {
+      if (priv->filter_flags != OOBS_USERS_FILTER_NONE)
+	{
+	  g_variant_get_child (user_variant, 0, "&s", &login);
+	  g_variant_get_child (user_variant, 2, "u", &uid);
+
+	  if (!user_matches_filter (priv, (*login) ? login : NULL, uid,
+				    minimum_uid, maximum_uid))
+	    {
+	      g_variant_unref (user_variant);
+	      continue;
+	    }
+	}
+
+      append_user (priv, _oobs_user_create_from_variant (NULL, user_variant, priv->fields));
+      g_variant_unref (user_variant);
+    }
+
+  g_variant_unref (users);
+
+  while (g_variant_iter_next (shells_iter, "s", &str))
+    priv->shells = g_list_prepend (priv->shells, str);
+
+  priv->shells = g_list_reverse (priv->shells);
+  g_variant_iter_free (shells_iter);
+
+  priv->minimum_uid = minimum_uid;
+  priv->maximum_uid = maximum_uid;
+
+  priv->default_home = (*home) ? g_strdup (home) : NULL;
+  priv->default_shell = (*shell) ? g_strdup (shell) : NULL;
+  priv->default_gid = gid;
+  priv->encrypted_home = encrypted_home;
+}
+#endif
+
+static void
+oobs_users_config_update (OobsObject *object)
+{
+  OobsUsersConfigPrivate *priv;
+  OobsObject      *groups_config;
+#ifdef HAVE_GDBUS
+  GVariant        *body;
+#endif
+
+  priv  = OOBS_USERS_CONFIG (object)->_priv;
+
+  /* First of all, free the previous configuration */
+  free_configuration (OOBS_USERS_CONFIG (object));
+
+#ifdef HAVE_GDBUS
+  body = _oobs_object_get_reply_variant (object);
+
+  if (body && g_variant_is_of_type (body, G_VARIANT_TYPE (USERS_REPLY_TYPE)))
+    update_from_variant (priv, body);
+  else
+#endif
+    update_from_message (priv, _oobs_object_get_dbus_message (object));
+
+  build_search_index (priv);
 
   groups_config = oobs_groups_config_get ();
 
@@ -388,6 +794,216 @@ oobs_users_config_commit (OobsObject *object)
   utils_append_boolean (&iter, priv->encrypted_home);
 }
 
+/*
+ * Filter and fields arguments are only appended if a filter or
+ * a field set is used, so the default message is understood by
+ * any backend.
+ */
+static void
+oobs_users_config_get_update_message (OobsObject *object)
+{
+  OobsUsersConfigPrivate *priv;
+  DBusMessageIter iter;
+  DBusMessage *message;
+
+  priv = OOBS_USERS_CONFIG (object)->_priv;
+
+  if (priv->filter_flags == OOBS_USERS_FILTER_NONE &&
+      priv->fields == OOBS_USER_FIELD_ALL)
+    return;
+
+  message = _oobs_object_get_dbus_message (object);
+  dbus_message_iter_init_append (message, &iter);
+
+  utils_append_uint (&iter, priv->filter_flags);
+  utils_append_uint (&iter, priv->filter_uid_min);
+  utils_append_uint (&iter, priv->filter_uid_max);
+  utils_append_string (&iter, priv->filter_login);
+  utils_append_uint (&iter, priv->fields);
+}
+
+static GHashTable*
+read_sessions (OobsUsersConfigPrivate *priv)
+{
+  GHashTable *sessions;
+  struct utmpx *entry;
+  struct stat st;
+  guint n_sessions;
+  gchar *login;
+
+  sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
+				    (GDestroyNotify) g_free, NULL);
+
+  if (stat (UTMP_PATH, &st) == 0)
+    {
+      priv->utmp_mtime = st.st_mtime;
+      priv->utmp_size = st.st_size;
+    }
+
+  setutxent ();
+
+  while ((entry = getutxent ()) != NULL)
+    {
+      if (entry->ut_type != USER_PROCESS)
+	continue;
+
+      /* ut_user isn't nul-terminated if it fills the whole field */
+      login = g_strndup (entry->ut_user, sizeof (entry->ut_user));
+      n_sessions = GPOINTER_TO_UINT (g_hash_table_lookup (sessions, login));
+      g_hash_table_insert (sessions, login, GUINT_TO_POINTER (n_sessions + 1));
+    }
+
+  /* close utmp */
+  endutxent ();
+
+  return sessions;
+}
+
+static void
+add_changed_logins (GHashTable *sessions,
+		    GHashTable *other_sessions,
+		    GHashTable *changed)
+{
+  GHashTableIter iter;
+  gpointer login;
+
+  g_hash_table_iter_init (&iter, sessions);
+
+  while (g_hash_table_iter_next (&iter, &login, NULL))
+    {
+      if (!g_hash_table_lookup (other_sessions, login))
+	g_hash_table_insert (changed, login, login);
+    }
+}
+
+/*
+ * Parses utmp again, and notifies about the users that
+ * logged in or out since it was last parsed.
+ */
+static void
+refresh_sessions (OobsUsersConfig *config)
+{
+  OobsUsersConfigPrivate *priv;
+  GHashTable *sessions, *old_sessions, *changed;
+  OobsListIter list_iter;
+  const gchar *login;
+  GObject *user;
+  gboolean valid;
+
+  priv = config->_priv;
+  sessions = read_sessions (priv);
+
+  if (!priv->sessions_loaded)
+    {
+      g_hash_table_destroy (priv->sessions);
+      priv->sessions = sessions;
+      priv->sessions_loaded = TRUE;
+      return;
+    }
+
+  changed = g_hash_table_new (g_str_hash, g_str_equal);
+  add_changed_logins (sessions, priv->sessions, changed);
+  add_changed_logins (priv->sessions, sessions, changed);
+
+  /* notify with the new sessions in place, the
+   * old ones still own some of the changed logins */
+  old_sessions = priv->sessions;
+  priv->sessions = sessions;
+
+  if (g_hash_table_size (changed) > 0)
+    {
+      valid = oobs_list_get_iter_first (priv->users_list, &list_iter);
+
+      while (valid)
+	{
+	  user = oobs_list_get (priv->users_list, &list_iter);
+	  login = oobs_user_get_login_name (OOBS_USER (user));
+
+	  if (login && g_hash_table_lookup (changed, login))
+	    {
+	      g_object_notify (user, "active");
+	      g_signal_emit (config, users_config_signals [USER_ACTIVE_CHANGED], 0, user);
+	    }
+
+	  g_object_unref (user);
+	  valid = oobs_list_iter_next (priv->users_list, &list_iter);
+	}
+    }
+
+  g_hash_table_destroy (changed);
+  g_hash_table_destroy (old_sessions);
+}
+
+static void
+oobs_users_config_utmp_changed (OobsUsersConfig *config)
+{
+  OobsUsersConfigPrivate *priv;
+
+  priv = config->_priv;
+
+  /* nobody asked yet, nothing to notify */
+  if (priv->sessions_loaded)
+    refresh_sessions (config);
+}
+
+static void
+oobs_users_config_utmp_monitor_stopped (OobsUsersConfig *config)
+{
+  OobsUsersConfigPrivate *priv;
+
+  priv = config->_priv;
+
+  /* fall back to checking utmp's modification time */
+  priv->sessions_monitored = FALSE;
+
+  if (priv->sessions_loaded)
+    refresh_sessions (config);
+}
+
+static gboolean
+utmp_stat_changed (OobsUsersConfigPrivate *priv)
+{
+  struct stat st;
+
+  if (stat (UTMP_PATH, &st) != 0)
+    return TRUE;
+
+  return (st.st_mtime != priv->utmp_mtime || st.st_size != priv->utmp_size);
+}
+
+/*
+ * Returns the number of sessions @login has open, utmp is parsed once and
+ * then only when it changes, either notified by the monitor or by polling
+ * its modification time if it can't be monitored.
+ */
+guint
+_oobs_users_config_get_n_sessions (OobsUsersConfig *config,
+				   const gchar     *login)
+{
+  OobsUsersConfigPrivate *priv;
+
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), 0);
+
+  priv = config->_priv;
+
+  if (!priv->monitor_started)
+    {
+      priv->sessions_monitored = utmp_monitor_init (config,
+						    oobs_users_config_utmp_changed,
+						    oobs_users_config_utmp_monitor_stopped);
+      priv->monitor_started = TRUE;
+    }
+
+  if (!priv->sessions_loaded ||
+      (!priv->sessions_monitored && utmp_stat_changed (priv)))
+    refresh_sessions (config);
+
+  if (!login)
+    return 0;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (priv->sessions, login));
+}
+
 /**
  * oobs_users_config_get:
  * 
@@ -459,10 +1075,14 @@ oobs_users_config_add_user (OobsUsersConfig *config, OobsUser *user)
     return result;
 
   priv = config->_priv;
+  ensure_search_index (priv);
 
   oobs_list_append (priv->users_list, &list_iter);
   oobs_list_set (priv->users_list, &list_iter, G_OBJECT (user));
 
+  index_user (priv, user);
+  stamp_search_index (priv);
+
   /* Adding a user can trigger the creation of its new main group,
    * which we need to take into account. */
   oobs_object_update (oobs_groups_config_get ());
@@ -470,6 +1090,135 @@ oobs_users_config_add_user (OobsUsersConfig *config, OobsUser *user)
   return OOBS_RESULT_OK;
 }
 
+typedef struct {
+  OobsResult *results;
+  guint index;
+} BatchData;
+
+static void
+batch_cb (OobsObject *object,
+	  OobsResult  result,
+	  gpointer    data)
+{
+  BatchData *batch_data = data;
+
+  batch_data->results[batch_data->index] = result;
+}
+
+/*
+ * Sends the add or delete requests for all the users before waiting for
+ * any reply, then fills @results with the result of each request.
+ */
+static void
+run_batch (OobsUser   **users,
+	   guint        n_users,
+	   gboolean     add,
+	   OobsResult  *results)
+{
+  BatchData *batch_data;
+  OobsResult result;
+  guint i;
+
+  batch_data = g_new (BatchData, n_users);
+
+  for (i = 0; i < n_users; i++)
+    {
+      /* stays this way if the request can't be sent */
+      results[i] = OOBS_RESULT_ERROR;
+      batch_data[i].results = results;
+      batch_data[i].index = i;
+
+      if (add)
+	result = oobs_object_add_async (OOBS_OBJECT (users[i]), batch_cb, &batch_data[i]);
+      else
+	result = oobs_object_delete_async (OOBS_OBJECT (users[i]), batch_cb, &batch_data[i]);
+
+      if (result != OOBS_RESULT_OK)
+	results[i] = result;
+    }
+
+  for (i = 0; i < n_users; i++)
+    oobs_object_process_requests (OOBS_OBJECT (users[i]));
+
+  g_free (batch_data);
+}
+
+/**
+ * oobs_users_config_add_users:
+ * @config: An #OobsUsersConfig.
+ * @users: array of #OobsUser.
+ * @n_users: number of elements in @users.
+ * @results: return location for an array of @n_users #OobsResult, or %NULL.
+ *
+ * Adds several users to the configuration, immediately committing changes
+ * to the system. All the requests are sent before waiting for any reply,
+ * and the groups configuration is updated just once after all of them
+ * have been processed, so this is much faster than calling
+ * oobs_users_config_add_user() for each user.
+ *
+ * The users that were successfully added are appended to the users list.
+ * If @results is not %NULL, it is filled with the result of each addition.
+ *
+ * Return value: %OOBS_RESULT_OK if all users were added, otherwise the
+ * first error found.
+ **/
+OobsResult
+oobs_users_config_add_users (OobsUsersConfig  *config,
+			     OobsUser        **users,
+			     guint             n_users,
+			     OobsResult       *results)
+{
+  OobsUsersConfigPrivate *priv;
+  OobsListIter list_iter;
+  OobsResult *user_results, result;
+  gboolean added = FALSE;
+  guint i;
+
+  g_return_val_if_fail (config != NULL, OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (users != NULL || n_users == 0, OOBS_RESULT_MALFORMED_DATA);
+
+  for (i = 0; i < n_users; i++)
+    g_return_val_if_fail (OOBS_IS_USER (users[i]), OOBS_RESULT_MALFORMED_DATA);
+
+  priv = config->_priv;
+  user_results = (results) ? results : g_new (OobsResult, n_users);
+
+  /* hash all passwords in parallel instead of one by one during commit */
+  if (priv->password_scheme != OOBS_PASSWORD_SCHEME_NONE)
+    oobs_users_config_hash_passwords (config, users, n_users);
+
+  run_batch (users, n_users, TRUE, user_results);
+
+  result = OOBS_RESULT_OK;
+  ensure_search_index (priv);
+
+  for (i = 0; i < n_users; i++)
+    {
+      if (user_results[i] == OOBS_RESULT_OK)
+	{
+	  oobs_list_append (priv->users_list, &list_iter);
+	  oobs_list_set (priv->users_list, &list_iter, G_OBJECT (users[i]));
+	  index_user (priv, users[i]);
+	  added = TRUE;
+	}
+      else if (result == OOBS_RESULT_OK)
+	result = user_results[i];
+    }
+
+  stamp_search_index (priv);
+
+  /* Adding users can trigger the creation of their new main groups,
+   * which we need to take into account. */
+  if (added)
+    oobs_object_update (oobs_groups_config_get ());
+
+  if (!results)
+    g_free (user_results);
+
+  return result;
+}
+
 /**
  * oobs_users_config_delete_user:
  * @config: An #OobsUsersConfig.
@@ -543,6 +1292,96 @@ oobs_users_config_delete_user (OobsUsersConfig *config, OobsUser *user)
   return OOBS_RESULT_OK;
 }
 
+/**
+ * oobs_users_config_delete_users:
+ * @config: An #OobsUsersConfig.
+ * @users: array of #OobsUser.
+ * @n_users: number of elements in @users.
+ * @results: return location for an array of @n_users #OobsResult, or %NULL.
+ *
+ * Deletes several users from the configuration, immediately committing
+ * changes to the system. All the requests are sent before waiting for any
+ * reply, then the deleted users are removed from all groups in a single
+ * pass over them, and from the users list at once, so this is much faster
+ * than calling oobs_users_config_delete_user() for each user.
+ *
+ * If @results is not %NULL, it is filled with the result of each deletion.
+ *
+ * Return value: %OOBS_RESULT_OK if all users were deleted, otherwise the
+ * first error found.
+ **/
+OobsResult
+oobs_users_config_delete_users (OobsUsersConfig  *config,
+				OobsUser        **users,
+				guint             n_users,
+				OobsResult       *results)
+{
+  OobsUsersConfigPrivate *priv;
+  OobsResult *user_results, result;
+  GHashTable *deleted_users, *deleted_logins;
+  OobsListIter list_iter;
+  OobsList *groups_list;
+  OobsGroup *group;
+  gboolean valid;
+  guint i;
+
+  g_return_val_if_fail (config != NULL, OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), OOBS_RESULT_MALFORMED_DATA);
+  g_return_val_if_fail (users != NULL || n_users == 0, OOBS_RESULT_MALFORMED_DATA);
+
+  for (i = 0; i < n_users; i++)
+    g_return_val_if_fail (OOBS_IS_USER (users[i]), OOBS_RESULT_MALFORMED_DATA);
+
+  priv = config->_priv;
+  user_results = (results) ? results : g_new (OobsResult, n_users);
+
+  run_batch (users, n_users, FALSE, user_results);
+
+  result = OOBS_RESULT_OK;
+  deleted_users = g_hash_table_new (NULL, NULL);
+  deleted_logins = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < n_users; i++)
+    {
+      if (user_results[i] == OOBS_RESULT_OK)
+	{
+	  g_hash_table_insert (deleted_users, users[i], users[i]);
+	  g_hash_table_insert (deleted_logins,
+			       (gpointer) oobs_user_get_login_name (users[i]),
+			       users[i]);
+	}
+      else if (result == OOBS_RESULT_OK)
+	result = user_results[i];
+    }
+
+  if (g_hash_table_size (deleted_users) > 0)
+    {
+      /* Remove users from all groups, to avoid committing to /etc/group
+       * the name of a non-existent user */
+      groups_list = oobs_groups_config_get_groups (OOBS_GROUPS_CONFIG (oobs_groups_config_get ()));
+      valid = oobs_list_get_iter_first (groups_list, &list_iter);
+
+      while (valid)
+	{
+	  group = OOBS_GROUP (oobs_list_get (groups_list, &list_iter));
+	  _oobs_group_remove_users (group, deleted_logins);
+	  g_object_unref (group);
+
+	  valid = oobs_list_iter_next (groups_list, &list_iter);
+	}
+
+      _oobs_list_remove_objects (priv->users_list, deleted_users);
+    }
+
+  g_hash_table_destroy (deleted_users);
+  g_hash_table_destroy (deleted_logins);
+
+  if (!results)
+    g_free (user_results);
+
+  return result;
+}
+
 /**
  * oobs_users_config_get_minimum_users_uid:
  * @config: An #OobsUsersConfig.
@@ -851,6 +1690,98 @@ oobs_users_config_get_from_uid (OobsUsersConfig *config, uid_t uid)
   return NULL;
 }
 
+static gboolean
+match_search_key (const gchar *key,
+		  const gchar *text,
+		  gboolean     word_prefix)
+{
+  const gchar *p = key;
+
+  while ((p = strstr (p, text)) != NULL)
+    {
+      if (!word_prefix || p == key ||
+	  p[-1] == SEARCH_KEY_SEPARATOR || p[-1] == ' ')
+	return TRUE;
+
+      p++;
+    }
+
+  return FALSE;
+}
+
+/**
+ * oobs_users_config_search_users:
+ * @config: An #OobsUsersConfig.
+ * @text: the text to look for.
+ * @word_prefix: whether @text must be found at the start of a word.
+ *
+ * Looks for the users whose login name, full name or any other GECOS
+ * field contains @text, ignoring case. If @word_prefix is %TRUE, only
+ * the matches at the start of a field or of a word inside it are taken
+ * into account. This uses an index that is kept along the users list,
+ * so it is suitable for filtering users as the user types.
+ *
+ * Return value: a newly allocated #GList of #OobsUser, in the same order
+ * as in the users list, to be freed with g_list_free(). Users are not
+ * referenced, they are only valid while they stay in the users list:
+ * deleting them, for example with oobs_users_config_delete_user(), or
+ * updating @config may free them. Reference the users you want to keep.
+ **/
+GList *
+oobs_users_config_search_users (OobsUsersConfig *config,
+				const gchar     *text,
+				gboolean         word_prefix)
+{
+  OobsUsersConfigPrivate *priv;
+  GArray *postings, *candidates;
+  GList *users = NULL;
+  gchar *query;
+  guint len, i, n;
+
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+
+  priv = config->_priv;
+  ensure_search_index (priv);
+
+  query = g_utf8_casefold (text, -1);
+  len = strlen (query);
+  candidates = NULL;
+
+  /* Any match contains all the n-grams of the query, so only the
+   * users containing the least common of them need to be checked.
+   * A single byte is too common to be worth indexing. */
+  for (i = 0; len >= 2 && (i == 0 || i + 3 <= len); i++)
+    {
+      postings = g_hash_table_lookup (priv->search_ngrams,
+				      GUINT_TO_POINTER (get_ngram (&query[i], MIN (len, 3))));
+      if (!postings)
+	{
+	  g_free (query);
+	  return NULL;
+	}
+
+      if (!candidates || postings->len < candidates->len)
+	candidates = postings;
+    }
+
+  n = (candidates) ? candidates->len : priv->search_users->len;
+
+  /* walk backwards, so prepending keeps the list order */
+  while (n > 0)
+    {
+      n--;
+      i = (candidates) ? g_array_index (candidates, guint, n) : n;
+
+      if (match_search_key (g_ptr_array_index (priv->search_keys, i), query, word_prefix))
+	users = g_list_prepend (users, g_ptr_array_index (priv->search_users, i));
+    }
+
+  g_free (query);
+
+  return users;
+}
+
 /**
  * oobs_users_config_is_login_used:
  * @config: An #OobsUsersConfig.
@@ -969,3 +1900,292 @@ oobs_users_config_find_free_uid (OobsUsersConfig *config, uid_t uid_min, uid_t u
    * we return the uid_max, which is the best we can do */
   return new_uid;
 }
+
+static gchar *
+get_crypt_setting (OobsUsersConfigPrivate *priv)
+{
+  gchar *salt, *setting;
+  const gchar *id;
+
+  switch (priv->password_scheme)
+    {
+    case OOBS_PASSWORD_SCHEME_MD5:
+      /* MD5 has neither a configurable cost nor a long salt */
+      salt = utils_get_random_string (8);
+      setting = g_strdup_printf ("$1$%s$", salt);
+      g_free (salt);
+      return setting;
+    case OOBS_PASSWORD_SCHEME_SHA256:
+      id = "5";
+      break;
+    case OOBS_PASSWORD_SCHEME_SHA512:
+      id = "6";
+      break;
+    default:
+      return NULL;
+    }
+
+  salt = utils_get_random_string (16);
+
+  if (priv->password_rounds > 0)
+    setting = g_strdup_printf ("$%s$rounds=%u$%s$", id, priv->password_rounds, salt);
+  else
+    setting = g_strdup_printf ("$%s$%s$", id, salt);
+
+  g_free (salt);
+
+  return setting;
+}
+
+static gchar *
+crypt_password (const gchar *password,
+		const gchar *setting)
+{
+  gchar *result;
+#ifdef HAVE_CRYPT_R
+  struct crypt_data *data;
+
+  /* struct crypt_data is too large to live in the stack of pool threads */
+  data = g_new0 (struct crypt_data, 1);
+  result = crypt_r (password, setting, data);
+
+  /* crypt_r() returns NULL or a "*" prefixed string on failure */
+  result = (result && *result != '*') ? g_strdup (result) : NULL;
+
+  memset (data, 0, sizeof (struct crypt_data));
+  g_free (data);
+#else
+  static GStaticMutex crypt_mutex = G_STATIC_MUTEX_INIT;
+
+  g_static_mutex_lock (&crypt_mutex);
+  result = crypt (password, setting);
+  result = (result && *result != '*') ? g_strdup (result) : NULL;
+  g_static_mutex_unlock (&crypt_mutex);
+#endif
+
+  return result;
+}
+
+static void
+hash_job_func (gpointer data,
+	       gpointer user_data)
+{
+  HashJob *job = data;
+
+  job->result = crypt_password (job->password, job->setting);
+}
+
+/*
+ * Returns the hash for @password with the configured
+ * scheme, or %NULL if password hashing is disabled.
+ */
+gchar *
+_oobs_users_config_hash_password (OobsUsersConfig *config,
+				  const gchar     *password)
+{
+  OobsUsersConfigPrivate *priv;
+  gchar *setting, *result;
+
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), NULL);
+  g_return_val_if_fail (password != NULL, NULL);
+
+  priv = config->_priv;
+  setting = get_crypt_setting (priv);
+
+  if (!setting)
+    return NULL;
+
+  result = crypt_password (password, setting);
+  g_free (setting);
+
+  return result;
+}
+
+/**
+ * oobs_users_config_set_filter:
+ * @config: An #OobsUsersConfig.
+ * @flags: #OobsUsersFilterFlags telling which criteria to apply.
+ * @uid_min: lowest UID to retrieve, used with %OOBS_USERS_FILTER_UID_RANGE.
+ * @uid_max: highest UID to retrieve, used with %OOBS_USERS_FILTER_UID_RANGE.
+ * @login_pattern: a glob-style pattern for login names, used with
+ * %OOBS_USERS_FILTER_LOGIN, or %NULL.
+ *
+ * Restricts the users retrieved on the next updates to those matching
+ * all the criteria given in @flags, so that the cost of updates depends
+ * on the number of users that are actually needed. The filter is sent
+ * to the backends, and applied again when parsing their reply.
+ *
+ * Note that the users list, and all the functions that use it such as
+ * oobs_users_config_is_uid_used() or oobs_users_config_find_free_uid(),
+ * will only take filtered users into account. Use
+ * %OOBS_USERS_FILTER_NONE to retrieve all users again.
+ **/
+void
+oobs_users_config_set_filter (OobsUsersConfig      *config,
+			      OobsUsersFilterFlags  flags,
+			      uid_t                 uid_min,
+			      uid_t                 uid_max,
+			      const gchar          *login_pattern)
+{
+  OobsUsersConfigPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_USERS_CONFIG (config));
+  g_return_if_fail (!(flags & OOBS_USERS_FILTER_LOGIN) || login_pattern != NULL);
+
+  priv = config->_priv;
+
+  g_free (priv->filter_login);
+  priv->filter_login = NULL;
+
+  if (priv->filter_pattern)
+    {
+      g_pattern_spec_free (priv->filter_pattern);
+      priv->filter_pattern = NULL;
+    }
+
+  priv->filter_flags = flags;
+  priv->filter_uid_min = uid_min;
+  priv->filter_uid_max = uid_max;
+
+  if (flags & OOBS_USERS_FILTER_LOGIN)
+    {
+      priv->filter_login = g_strdup (login_pattern);
+      priv->filter_pattern = g_pattern_spec_new (login_pattern);
+    }
+}
+
+/**
+ * oobs_users_config_set_fields:
+ * @config: An #OobsUsersConfig.
+ * @fields: #OobsUserFields to retrieve.
+ *
+ * Sets the optional fields retrieved for each user on the next
+ * updates. Leaving out fields that are not needed, like GECOS
+ * fields when only login names and UIDs are used, makes updates
+ * cheaper. The fields that were left out are retrieved separately
+ * for each user the first time they are accessed or modified.
+ * The default is %OOBS_USER_FIELD_ALL.
+ *
+ * Note that each of those retrievals is a blocking round trip to the
+ * backends, so reading a left out field on all users costs one call
+ * per user. If that's expected, include the field here instead.
+ * Since it would block, asynchronous commits of incomplete users
+ * fail with %OOBS_RESULT_MALFORMED_DATA.
+ **/
+void
+oobs_users_config_set_fields (OobsUsersConfig *config,
+			      OobsUserFields   fields)
+{
+  OobsUsersConfigPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_USERS_CONFIG (config));
+
+  priv = config->_priv;
+  priv->fields = fields & OOBS_USER_FIELD_ALL;
+}
+
+/**
+ * oobs_users_config_set_password_hashing:
+ * @config: An #OobsUsersConfig.
+ * @scheme: scheme used to hash passwords, or %OOBS_PASSWORD_SCHEME_NONE.
+ * @rounds: number of rounds for the SHA schemes, or 0 for the system default.
+ *
+ * Sets whether passwords set through oobs_user_set_password() are hashed
+ * on the client before being sent to the backends, instead of being sent
+ * as clear text and hashed there. This is disabled by default, and
+ * requires backends able to handle already hashed passwords.
+ *
+ * @rounds is ignored for %OOBS_PASSWORD_SCHEME_MD5.
+ **/
+void
+oobs_users_config_set_password_hashing (OobsUsersConfig    *config,
+					OobsPasswordScheme  scheme,
+					guint               rounds)
+{
+  OobsUsersConfigPrivate *priv;
+
+  g_return_if_fail (OOBS_IS_USERS_CONFIG (config));
+  g_return_if_fail (scheme <= OOBS_PASSWORD_SCHEME_SHA512);
+
+  priv = config->_priv;
+  priv->password_scheme = scheme;
+  priv->password_rounds = rounds;
+}
+
+/**
+ * oobs_users_config_hash_passwords:
+ * @config: An #OobsUsersConfig.
+ * @users: array of #OobsUser.
+ * @n_users: number of elements in @users.
+ *
+ * Hashes the new passwords of @users using a pool of threads, one
+ * per available processor, so committing many password changes
+ * doesn't have to hash them one at a time. Users without a new
+ * password, or whose password has already been hashed, are skipped.
+ *
+ * This does nothing unless password hashing has been enabled through
+ * oobs_users_config_set_password_hashing(). Passwords are hashed
+ * anyway during commit if this function isn't called.
+ **/
+void
+oobs_users_config_hash_passwords (OobsUsersConfig  *config,
+				  OobsUser        **users,
+				  guint             n_users)
+{
+  OobsUsersConfigPrivate *priv;
+  GThreadPool *pool;
+  HashJob *jobs;
+  const gchar *password;
+  glong n_cpus;
+  guint i;
+
+  g_return_if_fail (OOBS_IS_USERS_CONFIG (config));
+  g_return_if_fail (users != NULL || n_users == 0);
+
+  for (i = 0; i < n_users; i++)
+    g_return_if_fail (OOBS_IS_USER (users[i]));
+
+  priv = config->_priv;
+
+  if (priv->password_scheme == OOBS_PASSWORD_SCHEME_NONE || n_users == 0)
+    return;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  pool = g_thread_pool_new (hash_job_func, NULL, MAX (n_cpus, 1), TRUE, NULL);
+  jobs = g_new0 (HashJob, n_users);
+
+  for (i = 0; i < n_users; i++)
+    {
+      password = _oobs_user_get_password (users[i]);
+
+      if (!password || !*password || _oobs_user_get_password_crypted (users[i]))
+	continue;
+
+      /* salts are generated here, so workers only run crypt() */
+      jobs[i].password = g_strdup (password);
+      jobs[i].setting = get_crypt_setting (priv);
+      g_thread_pool_push (pool, &jobs[i], NULL);
+    }
+
+  /* waits for all jobs to finish */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < n_users; i++)
+    {
+      if (!jobs[i].password)
+	continue;
+
+      if (jobs[i].result)
+	_oobs_user_set_crypted_password (users[i], jobs[i].result);
+
+      memset (jobs[i].password, 0, strlen (jobs[i].password));
+      g_free (jobs[i].password);
+      g_free (jobs[i].setting);
+      g_free (jobs[i].result);
+    }
+
+  g_free (jobs);
+}
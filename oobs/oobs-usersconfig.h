@@ -39,6 +39,30 @@ G_BEGIN_DECLS
 typedef struct _OobsUsersConfig      OobsUsersConfig;
 typedef struct _OobsUsersConfigClass OobsUsersConfigClass;
 
+typedef enum {
+  OOBS_PASSWORD_SCHEME_NONE,
+  OOBS_PASSWORD_SCHEME_MD5,
+  OOBS_PASSWORD_SCHEME_SHA256,
+  OOBS_PASSWORD_SCHEME_SHA512
+} OobsPasswordScheme;
+
+/**
+ * OobsUsersFilterFlags:
+ * @OOBS_USERS_FILTER_NONE: Retrieve all users.
+ * @OOBS_USERS_FILTER_UID_RANGE: Only retrieve users whose UID is in a given range.
+ * @OOBS_USERS_FILTER_NON_SYSTEM: Only retrieve users whose UID is between the
+ *     minimum and maximum UIDs for non-system users.
+ * @OOBS_USERS_FILTER_LOGIN: Only retrieve users whose login name matches a pattern.
+ *
+ * Restrict the users retrieved by the backends, see oobs_users_config_set_filter().
+ */
+typedef enum {
+  OOBS_USERS_FILTER_NONE       = 0,
+  OOBS_USERS_FILTER_UID_RANGE  = 1,
+  OOBS_USERS_FILTER_NON_SYSTEM = 1 << 1,
+  OOBS_USERS_FILTER_LOGIN      = 1 << 2
+} OobsUsersFilterFlags;
+
 struct _OobsUsersConfig
 {
   OobsObject parent;
@@ -65,6 +89,31 @@ OobsList*   oobs_users_config_get_users    (OobsUsersConfig *config);
 OobsResult  oobs_users_config_add_user    (OobsUsersConfig *config, OobsUser *user);
 OobsResult  oobs_users_config_delete_user (OobsUsersConfig *config, OobsUser *user);
 
+OobsResult  oobs_users_config_add_users   (OobsUsersConfig  *config,
+                                           OobsUser        **users,
+                                           guint             n_users,
+                                           OobsResult       *results);
+OobsResult  oobs_users_config_delete_users (OobsUsersConfig  *config,
+                                            OobsUser        **users,
+                                            guint             n_users,
+                                            OobsResult       *results);
+
+void        oobs_users_config_set_filter           (OobsUsersConfig      *config,
+                                                    OobsUsersFilterFlags  flags,
+                                                    uid_t                 uid_min,
+                                                    uid_t                 uid_max,
+                                                    const gchar          *login_pattern);
+
+void        oobs_users_config_set_fields           (OobsUsersConfig      *config,
+                                                    OobsUserFields        fields);
+
+void        oobs_users_config_set_password_hashing (OobsUsersConfig    *config,
+                                                    OobsPasswordScheme  scheme,
+                                                    guint               rounds);
+void        oobs_users_config_hash_passwords       (OobsUsersConfig    *config,
+                                                    OobsUser          **users,
+                                                    guint               n_users);
+
 uid_t       oobs_users_config_get_minimum_users_uid (OobsUsersConfig *config);
 void        oobs_users_config_set_minimum_users_uid (OobsUsersConfig *config, uid_t uid);
 
@@ -87,6 +136,9 @@ OobsUser*   oobs_users_config_get_from_login       (OobsUsersConfig *config,
                                                     const gchar     *login);
 OobsUser*   oobs_users_config_get_from_uid         (OobsUsersConfig *config,
                                                     uid_t            uid);
+GList*      oobs_users_config_search_users         (OobsUsersConfig *config,
+                                                    const gchar     *text,
+                                                    gboolean         word_prefix);
 
 gboolean    oobs_users_config_is_login_used        (OobsUsersConfig *config,
                                                     const gchar     *login);
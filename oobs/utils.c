@@ -18,8 +18,12 @@
  * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
  */
 
+#include "config.h"
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <glib.h>
 #include "utils.h"
 
@@ -65,19 +69,65 @@ utils_get_string_list_from_dbus_reply (DBusMessage     *reply,
   return g_list_reverse (l);
 }
 
+static gboolean
+read_random_bytes (guchar *buf,
+		   gint    len)
+{
+  gint fd, done = 0;
+  ssize_t res;
+
+  fd = open ("/dev/urandom", O_RDONLY);
+
+  if (fd < 0)
+    return FALSE;
+
+  while (done < len)
+    {
+      res = read (fd, buf + done, len - done);
+
+      if (res < 0 && errno == EINTR)
+	continue;
+
+      if (res <= 0)
+	break;
+
+      done += res;
+    }
+
+  close (fd);
+  return (done == len);
+}
+
+/*
+ * Returns a string of len random characters from the crypt(3) salt
+ * alphabet, read from /dev/urandom so salts are unpredictable.
+ */
 gchar*
 utils_get_random_string (gint len)
 {
-  gchar  alphanum[] = "abcdefghijklmnopqrstuvwxyz0AB1CD2EF3GH4IJ5KL6MN7OP8QR9ST0UVWXYZ";
-  gchar *str;
-  gint   i, alnum_len;
+  static const gchar alphabet[] =
+    "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+  guchar *bytes;
+  gchar  *str;
+  gint    i;
 
   str = (gchar *) g_malloc0 (len + 1);
-  alnum_len = strlen (alphanum);
+  bytes = g_new (guchar, len);
 
+  if (!read_random_bytes (bytes, len))
+    {
+      /* GLib seeds its generator from /dev/urandom or the time */
+      g_warning ("Could not read /dev/urandom, salts will be weaker");
+
+      for (i = 0; i < len; i++)
+	bytes[i] = (guchar) g_random_int ();
+    }
+
+  /* the alphabet has 64 characters, so this isn't biased */
   for (i = 0; i < len; i++)
-    str[i] = alphanum [(gint) (((float) alnum_len * rand ()) / (RAND_MAX + 1.0))];
+    str[i] = alphabet [bytes[i] & 63];
 
+  g_free (bytes);
   return str;
 }
 
@@ -108,16 +158,38 @@ utils_append_boolean (DBusMessageIter *iter, gboolean value)
   dbus_message_iter_append_basic (iter, DBUS_TYPE_BOOLEAN, &value);
 }
 
+/* whether the message being read had its signature validated */
+static gboolean validated_reads = FALSE;
+
+/*
+ * Sets whether the utils_get_*() functions can skip type checks
+ * because the whole message signature was validated beforehand.
+ * Returns the previous value, so it can be restored.
+ */
+gboolean
+utils_set_validated_reads (gboolean validated)
+{
+  gboolean previous;
+
+  previous = validated_reads;
+  validated_reads = validated;
+
+  return previous;
+}
+
 static void
 utils_get_basic (DBusMessageIter *iter,
 		 gint             type,
 		 gpointer         value)
 {
-  if (G_UNLIKELY (dbus_message_iter_get_arg_type (iter) != type))
+  if (!validated_reads &&
+      G_UNLIKELY (dbus_message_iter_get_arg_type (iter) != type))
     {
+      /* leave the value untouched, callers provide a default */
       g_critical ("Different type while parsing message, found %c, expecting %c\n",
 		  dbus_message_iter_get_arg_type (iter), type);
-      g_assert_not_reached ();
+      dbus_message_iter_next (iter);
+      return;
     }
 
   dbus_message_iter_get_basic (iter, value);
@@ -127,7 +199,7 @@ utils_get_basic (DBusMessageIter *iter,
 G_CONST_RETURN gchar*
 utils_get_string (DBusMessageIter *iter)
 {
-  const gchar *str;
+  const gchar *str = NULL;
 
   utils_get_basic (iter, DBUS_TYPE_STRING, &str);
 
@@ -169,3 +241,321 @@ utils_get_boolean (DBusMessageIter *iter)
   utils_get_basic (iter, DBUS_TYPE_BOOLEAN, &value);
   return value;
 }
+
+static gboolean
+field_is_wanted (const UtilsField *field,
+		 guint             mask)
+{
+  if (field->flags & UTILS_FIELD_SKIP_DECODE ||
+      field->offset == UTILS_FIELD_NO_OFFSET)
+    return FALSE;
+
+  if (field->mask == 0)
+    return !(mask & UTILS_FIELD_MASK_ONLY);
+
+  return ((field->mask & mask) != 0);
+}
+
+static void
+set_field (const UtilsField *field,
+	   gpointer          base,
+	   const gchar      *str,
+	   guint32           value,
+	   GObject          *notify_object)
+{
+  gpointer location;
+
+  location = G_STRUCT_MEMBER_P (base, field->offset);
+
+  switch (field->type)
+    {
+    case UTILS_FIELD_STRING:
+      g_free (*(gchar **) location);
+      *(gchar **) location = (str && *str) ? g_strdup (str) : NULL;
+      break;
+    case UTILS_FIELD_INT:
+      *(gint *) location = (gint) value;
+      break;
+    case UTILS_FIELD_UINT:
+      *(guint32 *) location = value;
+      break;
+    case UTILS_FIELD_BOOLEAN:
+      *(gboolean *) location = (value != 0);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  if (notify_object && field->property)
+    g_object_notify (notify_object, field->property);
+}
+
+/*
+ * Decodes the fields described by the table from the message into
+ * the struct at base. Fields not in mask are skipped without being
+ * decoded, missing array elements are left empty. If notify_object
+ * is given, the property of each decoded field is notified.
+ */
+void
+utils_decode_fields (DBusMessageIter  *iter,
+		     const UtilsField *fields,
+		     guint             n_fields,
+		     guint             mask,
+		     gpointer          base,
+		     GObject          *notify_object)
+{
+  DBusMessageIter array_iter, *cur;
+  const UtilsField *field;
+  const gchar *str;
+  guint32 value;
+  gboolean skip_array = FALSE;
+  guint i;
+
+  cur = iter;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      field = &fields[i];
+
+      if (field->flags & UTILS_FIELD_ENCODE_ONLY)
+	continue;
+
+      if (field->type == UTILS_FIELD_ARRAY_BEGIN)
+	{
+	  skip_array = (field->mask != 0 && (field->mask & mask) == 0);
+
+	  if (!skip_array)
+	    {
+	      dbus_message_iter_recurse (iter, &array_iter);
+	      cur = &array_iter;
+	    }
+
+	  continue;
+	}
+      else if (field->type == UTILS_FIELD_ARRAY_END)
+	{
+	  skip_array = FALSE;
+	  cur = iter;
+	  dbus_message_iter_next (iter);
+	  continue;
+	}
+
+      if (skip_array)
+	continue;
+
+      if (cur == &array_iter &&
+	  dbus_message_iter_get_arg_type (cur) == DBUS_TYPE_INVALID)
+	{
+	  if (field_is_wanted (field, mask))
+	    set_field (field, base, NULL, 0, notify_object);
+
+	  continue;
+	}
+
+      if (!field_is_wanted (field, mask))
+	{
+	  dbus_message_iter_next (cur);
+	  continue;
+	}
+
+      str = NULL;
+      value = 0;
+
+      switch (field->type)
+	{
+	case UTILS_FIELD_STRING:
+	  str = utils_get_string (cur);
+	  break;
+	case UTILS_FIELD_INT:
+	  value = (guint32) utils_get_int (cur);
+	  break;
+	case UTILS_FIELD_UINT:
+	  value = utils_get_uint (cur);
+	  break;
+	case UTILS_FIELD_BOOLEAN:
+	  value = utils_get_boolean (cur);
+	  break;
+	default:
+	  g_assert_not_reached ();
+	}
+
+      set_field (field, base, str, value, notify_object);
+    }
+}
+
+/*
+ * Encodes the fields described by the table from the struct at base,
+ * fields without offset are sent empty.
+ */
+void
+utils_encode_fields (DBusMessageIter  *iter,
+		     const UtilsField *fields,
+		     guint             n_fields,
+		     gconstpointer     base)
+{
+  DBusMessageIter array_iter, *cur;
+  const UtilsField *field;
+  gconstpointer location;
+  guint i;
+
+  cur = iter;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      field = &fields[i];
+
+      if (field->type == UTILS_FIELD_ARRAY_BEGIN)
+	{
+	  dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY,
+					    DBUS_TYPE_STRING_AS_STRING, &array_iter);
+	  cur = &array_iter;
+	  continue;
+	}
+      else if (field->type == UTILS_FIELD_ARRAY_END)
+	{
+	  dbus_message_iter_close_container (iter, &array_iter);
+	  cur = iter;
+	  continue;
+	}
+
+      if (field->offset == UTILS_FIELD_NO_OFFSET)
+	{
+	  switch (field->type)
+	    {
+	    case UTILS_FIELD_STRING:
+	      utils_append_string (cur, NULL);
+	      break;
+	    case UTILS_FIELD_INT:
+	      utils_append_int (cur, 0);
+	      break;
+	    case UTILS_FIELD_UINT:
+	      utils_append_uint (cur, 0);
+	      break;
+	    case UTILS_FIELD_BOOLEAN:
+	      utils_append_boolean (cur, FALSE);
+	      break;
+	    default:
+	      g_assert_not_reached ();
+	    }
+
+	  continue;
+	}
+
+      location = G_STRUCT_MEMBER_P (base, field->offset);
+
+      switch (field->type)
+	{
+	case UTILS_FIELD_STRING:
+	  utils_append_string (cur, *(gchar * const *) location);
+	  break;
+	case UTILS_FIELD_INT:
+	  utils_append_int (cur, *(const gint *) location);
+	  break;
+	case UTILS_FIELD_UINT:
+	  utils_append_uint (cur, *(const guint32 *) location);
+	  break;
+	case UTILS_FIELD_BOOLEAN:
+	  utils_append_boolean (cur, *(const gboolean *) location);
+	  break;
+	default:
+	  g_assert_not_reached ();
+	}
+    }
+}
+
+#ifdef HAVE_GDBUS
+/*
+ * Same as utils_decode_fields(), decoding from the
+ * children of a GVariant struct instead of a message.
+ */
+void
+utils_decode_variant_fields (GVariant         *variant,
+			     const UtilsField *fields,
+			     guint             n_fields,
+			     guint             mask,
+			     gpointer          base,
+			     GObject          *notify_object)
+{
+  const UtilsField *field;
+  GVariant *array = NULL, *container, *child;
+  const gchar *str;
+  guint32 value;
+  gboolean skip_array = FALSE;
+  gsize index = 0, array_index = 0, pos;
+  guint i;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      field = &fields[i];
+
+      if (field->flags & UTILS_FIELD_ENCODE_ONLY)
+	continue;
+
+      if (field->type == UTILS_FIELD_ARRAY_BEGIN)
+	{
+	  skip_array = (field->mask != 0 && (field->mask & mask) == 0);
+
+	  if (!skip_array)
+	    {
+	      array = g_variant_get_child_value (variant, index);
+	      array_index = 0;
+	    }
+
+	  continue;
+	}
+      else if (field->type == UTILS_FIELD_ARRAY_END)
+	{
+	  if (array)
+	    g_variant_unref (array);
+
+	  array = NULL;
+	  skip_array = FALSE;
+	  index++;
+	  continue;
+	}
+
+      if (skip_array)
+	continue;
+
+      container = (array) ? array : variant;
+      pos = (array) ? array_index++ : index++;
+
+      if (!field_is_wanted (field, mask))
+	continue;
+
+      if (pos >= g_variant_n_children (container))
+	{
+	  set_field (field, base, NULL, 0, notify_object);
+	  continue;
+	}
+
+      child = g_variant_get_child_value (container, pos);
+      str = NULL;
+      value = 0;
+
+      switch (field->type)
+	{
+	case UTILS_FIELD_STRING:
+	  str = g_variant_get_string (child, NULL);
+	  break;
+	case UTILS_FIELD_INT:
+	  value = (guint32) g_variant_get_int32 (child);
+	  break;
+	case UTILS_FIELD_UINT:
+	  value = g_variant_get_uint32 (child);
+	  break;
+	case UTILS_FIELD_BOOLEAN:
+	  value = g_variant_get_boolean (child);
+	  break;
+	default:
+	  g_assert_not_reached ();
+	}
+
+      set_field (field, base, str, value, notify_object);
+      g_variant_unref (child);
+    }
+
+  if (array)
+    g_variant_unref (array);
+}
+#endif
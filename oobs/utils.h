@@ -24,7 +24,47 @@
 G_BEGIN_DECLS
 
 #include <dbus/dbus.h>
-#include <glib.h>
+#include <glib-object.h>
+
+#ifdef HAVE_GDBUS
+#include <gio/gio.h>
+#endif
+
+typedef enum {
+  UTILS_FIELD_STRING,
+  UTILS_FIELD_INT,
+  UTILS_FIELD_UINT,
+  UTILS_FIELD_BOOLEAN,
+  /* fields between these are sent as an array of strings */
+  UTILS_FIELD_ARRAY_BEGIN,
+  UTILS_FIELD_ARRAY_END
+} UtilsFieldType;
+
+typedef enum {
+  UTILS_FIELD_SKIP_DECODE = 1 << 0, /* sent by the backends, but not kept */
+  UTILS_FIELD_ENCODE_ONLY = 1 << 1  /* only sent to the backends */
+} UtilsFieldFlags;
+
+/* Used as offset for fields always sent empty */
+#define UTILS_FIELD_NO_OFFSET -1
+
+/* Or'ed to the mask given to the decoders to leave out the
+ * fields that are always present, keeping their values */
+#define UTILS_FIELD_MASK_ONLY (1u << 31)
+
+/*
+ * Describes a field of the structs exchanged with the backends,
+ * in order. offset is the location of the value in the private
+ * struct, strings there are owned. mask is the set of fields
+ * (see OobsUserFields) it belongs to, 0 if always present.
+ */
+typedef struct {
+  UtilsFieldType  type;
+  const gchar    *property;
+  glong           offset;
+  guint           mask;
+  guint           flags;
+} UtilsField;
 
 void   utils_create_dbus_array_from_string_list (GList *list, DBusMessage *message, DBusMessageIter *iter);
 GList *utils_get_string_list_from_dbus_reply    (DBusMessage *reply, DBusMessageIter *iter);
@@ -41,6 +81,28 @@ gint     utils_get_int                          (DBusMessageIter *iter);
 guint    utils_get_uint                         (DBusMessageIter *iter);
 gboolean utils_get_boolean                      (DBusMessageIter *iter);
 
+gboolean utils_set_validated_reads              (gboolean validated);
+
+void     utils_decode_fields                    (DBusMessageIter  *iter,
+						 const UtilsField *fields,
+						 guint             n_fields,
+						 guint             mask,
+						 gpointer          base,
+						 GObject          *notify_object);
+void     utils_encode_fields                    (DBusMessageIter  *iter,
+						 const UtilsField *fields,
+						 guint             n_fields,
+						 gconstpointer     base);
+
+#ifdef HAVE_GDBUS
+void     utils_decode_variant_fields            (GVariant         *variant,
+						 const UtilsField *fields,
+						 guint             n_fields,
+						 guint             mask,
+						 gpointer          base,
+						 GObject          *notify_object);
+#endif
+
 G_END_DECLS
 
 #endif /* __OOBS_UTILS_H__ */
@@ -0,0 +1,182 @@
+/* -*- Mode: C; c-file-style: "gnu"; tab-width: 8 -*- */
+/* Copyright (C) 2007 Carlos Garnacho
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
+ */
+
+#include <glib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "utmp-monitor.h"
+
+#define BUF_SIZE 4096
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct MonitorData MonitorData;
+
+struct MonitorData {
+  OobsUsersConfig *config;
+  UtmpMonitorFunc  func;
+  UtmpMonitorFunc  stopped_func;
+  GIOChannel      *channel;
+  guint            channel_source_id;
+  guint            idle_id;
+  gint             wd;
+};
+
+static gboolean
+monitor_data_idle (MonitorData *data)
+{
+  data->idle_id = 0;
+  (data->func) (data->config);
+
+  return FALSE;
+}
+
+static gboolean
+monitor_data_channel_watch (GIOChannel   *channel,
+			    GIOCondition  condition,
+			    MonitorData  *data)
+{
+  struct inotify_event *event;
+  char buf[BUF_SIZE];
+  ssize_t size, i = 0;
+  gint fd;
+
+  fd = g_io_channel_unix_get_fd (channel);
+  size = read (fd, buf, BUF_SIZE);
+
+  if (size < 0 && (errno == EINTR || errno == EAGAIN))
+    return TRUE;
+
+  if (size <= 0)
+    {
+      /* don't spin on a broken descriptor, let the caller poll instead */
+      g_warning ("Could not read inotify event, stopped monitoring %s", UTMP_PATH);
+
+      data->channel_source_id = 0;
+      (data->stopped_func) (data->config);
+
+      return FALSE;
+    }
+
+  while (i < size)
+    {
+      event = (struct inotify_event *) &buf[i];
+
+      /* the file was replaced, watch the new one */
+      if (event->mask & IN_IGNORED)
+	{
+	  data->wd = inotify_add_watch (fd, UTMP_PATH, WATCH_MASK);
+
+	  /* it may be briefly missing, nothing would be watched then */
+	  if (data->wd < 0)
+	    {
+	      g_warning ("Could not watch %s again, stopped monitoring it", UTMP_PATH);
+
+	      data->channel_source_id = 0;
+	      (data->stopped_func) (data->config);
+
+	      return FALSE;
+	    }
+	}
+
+      i += sizeof (struct inotify_event) + event->len;
+    }
+
+  /* every login writes several times to utmp,
+   * so just notify once all writes are done */
+  if (!data->idle_id)
+    data->idle_id = g_idle_add ((GSourceFunc) monitor_data_idle, data);
+
+  return TRUE;
+}
+
+static void
+monitor_data_free (MonitorData *data)
+{
+  if (data->idle_id)
+    g_source_remove (data->idle_id);
+
+  if (data->channel_source_id)
+    g_source_remove (data->channel_source_id);
+
+  g_io_channel_shutdown (data->channel, FALSE, NULL);
+  g_io_channel_unref (data->channel);
+  g_free (data);
+}
+
+static MonitorData*
+init_monitor_data (OobsUsersConfig *config,
+		   UtmpMonitorFunc  func,
+		   UtmpMonitorFunc  stopped_func)
+{
+  MonitorData *data;
+  gint fd, wd;
+
+  fd = inotify_init ();
+
+  if (fd < 0)
+    return NULL;
+
+  wd = inotify_add_watch (fd, UTMP_PATH, WATCH_MASK);
+
+  if (wd < 0)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  data = g_new0 (MonitorData, 1);
+  data->func = func;
+  data->stopped_func = stopped_func;
+  data->config = config;
+  data->wd = wd;
+  data->channel = g_io_channel_unix_new (fd);
+  data->channel_source_id = g_io_add_watch (data->channel,
+					    G_IO_IN | G_IO_ERR | G_IO_HUP,
+					    (GIOFunc) monitor_data_channel_watch,
+					    data);
+  return data;
+}
+
+gboolean
+utmp_monitor_init (OobsUsersConfig *config,
+		   UtmpMonitorFunc  func,
+		   UtmpMonitorFunc  stopped_func)
+{
+  static GQuark quark = 0;
+  MonitorData *data;
+
+  g_return_val_if_fail (OOBS_IS_USERS_CONFIG (config), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+  g_return_val_if_fail (stopped_func != NULL, FALSE);
+
+  if (G_UNLIKELY (!quark))
+    quark = g_quark_from_static_string ("utmp-monitor-data");
+
+  data = init_monitor_data (config, func, stopped_func);
+
+  if (!data)
+    return FALSE;
+
+  g_object_set_qdata_full (G_OBJECT (config), quark,
+			   data, (GDestroyNotify) monitor_data_free);
+  return TRUE;
+}
@@ -0,0 +1,46 @@
+/* -*- Mode: C; c-file-style: "gnu"; tab-width: 8 -*- */
+/* Copyright (C) 2007 Carlos Garnacho
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Authors: Carlos Garnacho Parro  <carlosg@gnome.org>
+ */
+
+#ifndef __UTMP_MONITOR_H
+#define __UTMP_MONITOR_H
+
+G_BEGIN_DECLS
+
+#include <utmpx.h>
+#include "oobs-usersconfig.h"
+
+#ifdef UTMPX_FILE
+#define UTMP_PATH UTMPX_FILE
+#else
+#define UTMP_PATH "/var/run/utmp"
+#endif
+
+typedef void (*UtmpMonitorFunc) (OobsUsersConfig *config);
+
+/* func is called when utmp changes, stopped_func if the
+ * monitor fails later on and utmp has to be polled again */
+gboolean utmp_monitor_init (OobsUsersConfig *config,
+			    UtmpMonitorFunc  func,
+			    UtmpMonitorFunc  stopped_func);
+
+
+G_END_DECLS
+
+#endif /* __UTMP_MONITOR_H */